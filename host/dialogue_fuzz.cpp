@@ -0,0 +1,637 @@
+/**
+ * @file dialogue_fuzz.cpp
+ * @brief random and hostile edge sequences through the decoders, with
+ *        invariant checks and timing
+ *
+ * Usage: dialogue_fuzz [--calls N] [--seed N]
+ *
+ * Generates N calls (default 20000) from a seeded PRNG and plays them
+ * through the same code as dialogue_sim, looping like the firmware does
+ * with --sleep. There are three kinds of call:
+ *
+ *   clean    10 and 20 pps dials within spec, with contact bounce on every
+ *            edge and sub-millisecond glitches inside breaks and makes
+ *   noisy    the same, plus relay clicks (6-11 ms breaks) between digits
+ *            and contact chatter (5.5-7 ms makes) splitting breaks
+ *   hostile  digits of more than ten pulses, hanging up in mid-digit and
+ *            a flapping hook switch
+ *
+ * Clean and noisy calls must type exactly the digits that were dialled.
+ * Hostile calls must type the well-formed digits only: nothing for a digit
+ * of more than ten pulses, nor for one cut short by hanging up. Every call
+ * must keep these invariants:
+ *
+ *   - no digit is typed while on-hook;
+ *   - macros start at least MACRO_MIN_INTERVAL_MS apart;
+ *   - a keyboard report holds one key at most, digits without modifiers.
+ *
+ * Then relay clicks go inside the makes of a 10 pps 60/40 dial, straight
+ * into DialTiming: none may count as a pulse, call a pulse odd or move
+ * the learned period, and only real periods may count toward the
+ * calibration.
+ *
+ * The run ends with the decode rate against wall-clock time and the cost
+ * of each core's loop pass in cycles (TSC on x86, else ns). With the same
+ * seed and call count the input is identical, so the numbers can be
+ * compared across commits. Last, each dial code and the boot code is
+ * dialled on its own, where it must fire, and inside longer numbers, where
+ * it must not. Exits 1 if any call was misdecoded, an
+ * invariant broke, the relay clicks got through or a code fired wrongly.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "hal_sim.h"
+#include "class/hid/hid.h"
+#include "config.h"
+#include "dial_timing.h"
+#include "dialer.h"
+#include "hid_queue.h"
+#include "keyboard.h"
+#include "macro.h"
+#include "phone.h"
+#include "stats.h"
+#include "timers.h"
+#include "usb_descriptors.h"
+
+enum CallKind
+{
+    CALL_CLEAN,
+    CALL_NOISY,
+    CALL_HOSTILE,
+    CALL_KINDS
+};
+
+struct Edge
+{
+    uint64_t time_us;
+    uint8_t  pin;
+    bool     level;
+};
+
+struct KindResult
+{
+    uint32_t calls;
+    uint32_t digits;
+    uint32_t misdecoded;    // calls that typed something else
+};
+
+struct CycleStats
+{
+    uint64_t total;
+    uint64_t max;
+    uint64_t passes;
+    uint64_t buckets[64];   // log2 of the cycle count
+};
+
+static std::mt19937_64 rng;
+
+static double uniform(double lo, double hi)
+{
+    return std::uniform_real_distribution<double>(lo, hi)(rng);
+}
+
+static int between(int lo, int hi)
+{
+    return std::uniform_int_distribution<int>(lo, hi)(rng);
+}
+
+static bool chance(double p)
+{
+    return uniform(0, 1) < p;
+}
+
+static uint64_t cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+static void cycles_add(CycleStats &s, uint64_t c)
+{
+    s.total += c;
+    s.max    = std::max(s.max, c);
+    s.passes++;
+    s.buckets[c ? 63 - __builtin_clzll(c) : 0]++;
+}
+
+// upper bound of the bucket that holds the 99th percentile
+static uint64_t cycles_p99(const CycleStats &s)
+{
+    uint64_t seen = 0;
+    for (int b = 0; b < 64; b++)
+    {
+        seen += s.buckets[b];
+        if (seen * 100 >= s.passes * 99)
+        {
+            return 2ull << b;
+        }
+    }
+    return s.max;
+}
+
+//--------------------------------------------------------------------+
+// Call generator
+//--------------------------------------------------------------------+
+
+struct Call
+{
+    CallKind           kind;
+    std::vector<Edge>  edges;
+    std::string        expected;    // digits the call types, the well-formed ones
+    uint64_t           end_us;      // everything is decided by then
+};
+
+// an edge with optional contact bounce: whole pairs of extra flips in
+// the next bounce_us, so the line ends up at level
+static void drive(Call &c, uint8_t pin, bool level, double at_us, double bounce_us)
+{
+    c.edges.push_back({ (uint64_t)at_us, pin, level });
+    if (bounce_us <= 0 || !chance(0.7))
+    {
+        return;
+    }
+
+    std::vector<double> flips(2 * between(1, 3));
+    for (double &f : flips) f = at_us + uniform(20, bounce_us);
+    std::sort(flips.begin(), flips.end());
+    for (size_t i = 0; i < flips.size(); i++)
+    {
+        c.edges.push_back({ (uint64_t)flips[i], pin, (i % 2) ? level : !level });
+    }
+}
+
+// a spike of the other level well inside [from_us, to_us]
+static void glitch(Call &c, uint8_t pin, bool level, double from_us, double to_us)
+{
+    double margin = (PULSE_DEBOUNCE_MS + 2) * 1000.0;
+    if (to_us - from_us < 3 * margin)
+    {
+        return;
+    }
+    double at = uniform(from_us + margin, to_us - margin);
+    c.edges.push_back({ (uint64_t)at, pin, !level });
+    c.edges.push_back({ (uint64_t)(at + uniform(50, 2000)), pin, level });
+}
+
+// the hook switch going up and down at random, ending on-hook
+static double flap(Call &c, double t)
+{
+    int toggles = 2 * between(3, 15);
+    for (int i = 0; i < toggles; i++)
+    {
+        t += uniform(5000, 150000);
+        c.edges.push_back({ (uint64_t)t, (uint8_t)config.hangup_pin, (i % 2) == 1 });
+    }
+    return t + 200000;
+}
+
+static Call make_call(CallKind kind, double t)
+{
+    Call    c;
+    uint8_t pulse = (uint8_t)config.pulse_pin;
+    uint8_t hook  = (uint8_t)config.hangup_pin;
+
+    c.kind = kind;
+    if (kind == CALL_HOSTILE && chance(0.3))
+    {
+        t = flap(c, t);
+    }
+
+    drive(c, hook, false, t, 10000);
+    t += uniform(300000, 800000);
+
+    bool aborted = false;
+    int  digits  = between(1, 6);
+    for (int d = 0; d < digits && !aborted; d++)
+    {
+        int    pulses = (kind == CALL_HOSTILE && chance(0.2)) ? between(11, 14) : between(1, 10);
+        double pps    = chance(0.3) ? uniform(18, 22) : uniform(8, 12);
+        double period = 1e6 / pps;
+        double brk    = period * uniform(0.55, 0.70);
+        int    cut    = (kind == CALL_HOSTILE && chance(0.15)) ? between(1, pulses) : 0;
+
+        for (int p = 1; p <= pulses; p++)
+        {
+            drive(c, pulse, false, t, 3000);
+            drive(c, pulse, true, t + brk, 3000);
+            if (kind != CALL_CLEAN && chance(0.1) && brk > 40000)
+            {
+                // one chatter per break, a glitch next to it would make it a real make
+                double at = t + uniform(20000, brk - 20000);
+                c.edges.push_back({ (uint64_t)at, pulse, true });
+                c.edges.push_back({ (uint64_t)(at + uniform(5500, 7000)), pulse, false });
+            }
+            else if (chance(0.2))
+            {
+                glitch(c, pulse, false, t, t + brk);
+            }
+            if (chance(0.2)) glitch(c, pulse, true, t + brk, t + period);
+            if (p == cut)
+            {
+                // hang up during the next break
+                drive(c, pulse, false, t + period, 3000);
+                t += period + brk / 2;
+                aborted = true;
+                break;
+            }
+            t += period;
+        }
+        if (aborted)
+        {
+            break;
+        }
+        if (pulses <= 10)
+        {
+            c.expected += (char)('0' + pulses % 10);
+        }
+
+        double gap = uniform(300000, 1200000);
+        if (kind != CALL_CLEAN && chance(0.5))
+        {
+            double at = t + uniform(gap / 3, gap * 2 / 3);
+            drive(c, pulse, false, at, 0);
+            drive(c, pulse, true, at + uniform(6000, 11000), 0);
+        }
+        t += gap;
+    }
+
+    drive(c, hook, true, t, 10000);
+    if (aborted)
+    {
+        drive(c, pulse, true, t + 20000, 3000);   // the dial comes to rest
+    }
+    t += 100000;
+    if (kind == CALL_HOSTILE && chance(0.3))
+    {
+        t = flap(c, t);
+    }
+
+    std::stable_sort(c.edges.begin(), c.edges.end(),
+                     [](const Edge &x, const Edge &y) { return x.time_us < y.time_us; });
+    c.end_us = (uint64_t)t + uniform(300000, 1000000);
+    return c;
+}
+
+//--------------------------------------------------------------------+
+// Checks
+//--------------------------------------------------------------------+
+
+static bool     off_hook      = false;
+static uint32_t macro_count[DIAL_LINES];    // sim_macros_started() at the last check
+static uint64_t macro_at_us[DIAL_LINES];
+static uint32_t digit_on_hook = 0;
+static uint32_t macros_close  = 0;
+static uint32_t malformed     = 0;
+static uint64_t decoded       = 0;
+
+static bool digit_key(uint8_t key)
+{
+    return key >= HID_KEY_1 && key <= HID_KEY_0;
+}
+
+// returns what the call typed
+static std::string check_reports(void)
+{
+    std::string typed;
+    for (const SimReport &r : sim_reports())
+    {
+        if (r.report_id == REPORT_ID_TELEPHONY)
+        {
+            off_hook = (r.buttons & PHONE_HOOK_SWITCH) != 0;
+            decoded++;
+            continue;
+        }
+        if (r.report_id != REPORT_ID_KEYBOARD || r.keycode[0] == 0)
+        {
+            continue;       // a release
+        }
+        for (int i = 1; i < 6; i++)
+        {
+            if (r.keycode[i]) malformed++;
+        }
+
+        uint8_t key = r.keycode[0];
+        if (digit_key(key) && !r.modifier)
+        {
+            if (!off_hook) digit_on_hook++;
+            typed += key == HID_KEY_0 ? '0' : (char)('1' + key - HID_KEY_1);
+            decoded++;
+            continue;
+        }
+        if (digit_key(key))
+        {
+            malformed++;
+        }
+    }
+    sim_clear_reports();
+    return typed;
+}
+
+// after every pass: a macro macro_run() accepted must come at least
+// MACRO_MIN_INTERVAL_MS after the line's previous one, and one per pass
+static void check_macros(void)
+{
+    for (uint8_t line = 0; line < DIAL_LINES; line++)
+    {
+        uint64_t at_us;
+        uint32_t count = sim_macros_started(line, &at_us);
+        if (count == macro_count[line])
+        {
+            continue;
+        }
+        if (count - macro_count[line] > 1 ||
+            (macro_count[line] && at_us - macro_at_us[line] < MACRO_MIN_INTERVAL_MS * 1000ull))
+        {
+            macros_close++;
+        }
+        macro_count[line] = count;
+        macro_at_us[line] = at_us;
+    }
+}
+
+// Clicks of 6-11 ms, 12-18 ms into a make so that neither make is taken
+// for chatter. Returns the number of problems found.
+static uint32_t relay_check(uint32_t digits)
+{
+    DialTiming t;
+    t.load(0, 0);       // the defaults, 10 pps 60/40
+    t.set_timeout_max_us(DialTiming::TIMEOUT_MAX_US);
+
+    const uint32_t period = DialTiming::DEFAULT_PERIOD_US;
+    const uint32_t brk    = DialTiming::DEFAULT_BREAK_US;
+    uint64_t now      = 1000000;
+    uint32_t problems = 0, clicks = 0;
+
+    for (uint32_t d = 0; d < digits; d++)
+    {
+        int      pulses  = between(1, 10);
+        uint32_t counted = 0, noise = 0, heard = 0, samples = t.samples;
+        for (int p = 0; p < pulses; p++, now += period)
+        {
+            DialTiming::Pulse v = t.on_break(now);
+            counted += v == DialTiming::PULSE_OK;
+            noise   += v == DialTiming::PULSE_NOISE;
+            t.on_make(now + brk);
+            if (chance(0.5))
+            {
+                uint64_t at = now + brk + (uint64_t)uniform(12000, 18000);
+                v = t.on_break(at);
+                counted += v == DialTiming::PULSE_OK;
+                noise   += v == DialTiming::PULSE_NOISE;
+                t.on_make(at + (uint64_t)uniform(6000, 11000));
+                heard++;
+            }
+        }
+        DialTiming::Pulse v = t.end_digit();
+        counted += v == DialTiming::PULSE_OK;
+        noise   += v == DialTiming::PULSE_NOISE;
+        now += 1000000;
+
+        // every pulse but the last of a digit has a period to learn from
+        if (counted != (uint32_t)pulses || noise != heard || t.samples - samples != (uint32_t)pulses - 1)
+        {
+            problems++;
+        }
+        clicks += heard;
+    }
+
+    uint32_t odd   = t.take_odd();
+    uint32_t drift = t.period_us() > period ? t.period_us() - period : period - t.period_us();
+    printf("relay clicks: %u in makes, odd pulses %u, learned period %u us\n", clicks, odd,
+           t.period_us());
+    return problems + odd + (drift > period / 100);
+}
+
+//--------------------------------------------------------------------+
+// Main loop
+//--------------------------------------------------------------------+
+
+static CycleStats core0, core1;
+
+// plays the edges up to end_us, one pass per edge or timer like the firmware
+static void run(const std::vector<Edge> &edges, uint64_t end_us)
+{
+    size_t   next = 0;
+    uint64_t t    = sim_time_us();
+
+    while (t <= end_us)
+    {
+        while (next < edges.size() && edges[next].time_us <= t)
+        {
+            sim_set_time_us(edges[next].time_us);
+            sim_set_pin(edges[next].pin, edges[next].level);
+            ++next;
+        }
+        sim_set_time_us(t);
+
+        uint64_t c = cycles();
+        edge_task();
+        timers_run(1, t);
+        cycles_add(core1, cycles() - c);
+
+        sim_usb_task();
+        c = cycles();
+        dial_event_task();
+        hid_task();
+        hid_queue_task();
+        timers_run(0, t);
+        cycles_add(core0, cycles() - c);
+        check_macros();
+
+        uint64_t wake = std::min({ timers_next_us(0), timers_next_us(1),
+                                   sim_usb_next_deadline_us(), end_us + 1 });
+        if (next < edges.size())
+        {
+            wake = std::min(wake, edges[next].time_us);
+        }
+        t = std::max(wake, t + 1);
+    }
+}
+
+// A clean call at 10 pps that dials digits, then hangs up
+static Call dialled_call(const char *digits, double t)
+{
+    Call    c;
+    uint8_t pulse = (uint8_t)config.pulse_pin;
+    uint8_t hook  = (uint8_t)config.hangup_pin;
+
+    c.kind = CALL_CLEAN;
+    drive(c, hook, false, t, 0);
+    t += 500000;
+    for (const char *d = digits; *d; d++)
+    {
+        int pulses = *d == '0' ? 10 : *d - '0';
+        for (int p = 0; p < pulses; p++, t += 100000)
+        {
+            drive(c, pulse, false, t, 0);
+            drive(c, pulse, true, t + 60000, 0);
+        }
+        t += 700000;
+    }
+    drive(c, hook, true, t, 0);
+    c.expected = digits;
+    c.end_us   = (uint64_t)t + 500000;
+    return c;
+}
+
+// Whether the call set off a code while off-hook: a macro key, Phone Mute
+// or a reboot. The hang-up macro after hanging up doesn't count.
+static bool code_fired(uint32_t reboots)
+{
+    bool up = false, fired = sim_reboots() != reboots;
+    for (const SimReport &r : sim_reports())
+    {
+        if (r.report_id == REPORT_ID_TELEPHONY)
+        {
+            up     = (r.buttons & PHONE_HOOK_SWITCH) != 0;
+            fired |= (r.buttons & PHONE_MUTE) != 0;
+        }
+        else if (r.report_id == REPORT_ID_KEYBOARD && r.keycode[0] && up)
+        {
+            fired |= r.modifier || !digit_key(r.keycode[0]);
+        }
+    }
+    sim_clear_reports();
+    return fired;
+}
+
+// Every dial code and the boot code must fire when dialled as a call's
+// first digits, and never inside a longer number. Returns the number of
+// calls that got this wrong.
+static uint32_t codes_check(void)
+{
+    static const char *const codes[] = { "0001", "0002", "0003", "1234" };
+    uint32_t problems = 0, numbers = 0;
+
+    for (const char *code : codes)
+    {
+        std::string alone = code;
+        std::string inside[] = { "1" + alone, "55" + alone + "9", "0" + alone, alone.substr(0, 3) + alone };
+
+        uint32_t reboots = sim_reboots();
+        Call     c       = dialled_call(code, (double)sim_time_us() + 1000);
+        run(c.edges, c.end_us);
+        problems += !code_fired(reboots);
+
+        for (const std::string &number : inside)
+        {
+            reboots = sim_reboots();
+            c       = dialled_call(number.c_str(), (double)sim_time_us() + 1000);
+            run(c.edges, c.end_us);
+            problems += code_fired(reboots);
+            numbers++;
+        }
+    }
+    printf("dial codes: %u numbers holding a code, %u problems\n", numbers, problems);
+    return problems;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t calls = 20000;
+    uint64_t seed  = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--calls") && i + 1 < argc)
+            calls = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc)
+            seed = strtoull(argv[++i], NULL, 0);
+        else
+        {
+            fprintf(stderr, "usage: %s [--calls N] [--seed N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    rng.seed(seed);
+    config_load(KeyBoard::key_mask);
+    config_set(CONFIG_HANG_UP_MACRO, 1);    // so hook flapping runs macros
+    sim_set_time_us(0);
+    dialer_init();
+
+    static const char *const kind_names[CALL_KINDS] = { "clean", "noisy", "hostile" };
+    KindResult results[CALL_KINDS] = {};
+    uint64_t   edges = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t n = 0; n < calls; n++)
+    {
+        CallKind kind = (CallKind)(n % 4 == 3 ? CALL_HOSTILE : n % 4 == 2 ? CALL_NOISY : CALL_CLEAN);
+        Call     c    = make_call(kind, (double)sim_time_us() + 1000);
+
+        run(c.edges, c.end_us);
+        std::string typed = check_reports();
+
+        KindResult &r = results[kind];
+        r.calls++;
+        r.digits += (uint32_t)c.expected.size();
+        if (typed != c.expected)
+        {
+            r.misdecoded++;
+            if (r.misdecoded <= 5)
+            {
+                fprintf(stderr, "%s call %u at %.3f ms: dialled %s, typed %s\n", kind_names[kind], n,
+                        c.edges.front().time_us / 1000.0, c.expected.c_str(), typed.c_str());
+            }
+        }
+        edges += c.edges.size();
+    }
+    double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("seed %llu, %u calls, %llu edges, %.1f s simulated\n", (unsigned long long)seed, calls,
+           (unsigned long long)edges, sim_time_us() / 1e6);
+    for (int k = 0; k < CALL_KINDS; k++)
+    {
+        printf("%-8s calls %-7u digits %-8u misdecoded %u\n", kind_names[k], results[k].calls,
+               results[k].digits, results[k].misdecoded);
+    }
+
+    StatsCounters sc;
+    stats_read_counters(&sc);
+    printf("counters: bad digits %u, noise pulses %u, odd pulses %u, edge drops %u, hid drops %u\n",
+           sc.counters[COUNTER_BAD_DIGITS], sc.counters[COUNTER_NOISE_PULSES],
+           sc.counters[COUNTER_ODD_PULSES], sc.counters[COUNTER_EDGE_DROPS],
+           sc.counters[COUNTER_HID_DROPS]);
+    printf("invariants: digits on-hook %u, macros too close %u, malformed reports %u\n",
+           digit_on_hook, macros_close, malformed);
+    uint32_t relay_problems = relay_check(500);
+
+    printf("decoded %llu events in %.3f s, %.0f events/s, %.0f edges/s\n",
+           (unsigned long long)decoded, wall_s, decoded / wall_s, edges / wall_s);
+    const char *unit = "cycles";
+#if !defined(__x86_64__) && !defined(__i386__)
+    unit = "ns";
+#endif
+    const CycleStats *cores[2] = { &core0, &core1 };
+    for (int core = 0; core < 2; core++)
+    {
+        const CycleStats &s = *cores[core];
+        printf("core %d pass: %llu passes, mean %.0f, p99 < %llu, max %llu %s\n", core,
+               (unsigned long long)s.passes, (double)s.total / s.passes,
+               (unsigned long long)cycles_p99(s), (unsigned long long)s.max, unit);
+    }
+
+    // after the timing, so the extra calls don't move it
+    uint32_t code_problems = codes_check();
+
+    bool failed = relay_problems || code_problems || results[CALL_CLEAN].misdecoded || results[CALL_NOISY].misdecoded ||
+                  results[CALL_HOSTILE].misdecoded || digit_on_hook || macros_close || malformed;
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,291 @@
+/**
+ * @file dialogue_sim.cpp
+ * @brief replay an edge trace through the dialer logic faster than real time
+ *
+ * Usage: dialogue_sim [--step-us N | --sleep] [--hid-interval-us N]
+ *                     [--macro-gap-ms N] [--config FIELD=VALUE]...
+ *                     [--tail-ms N] [--stats] [trace]
+ *
+ * The trace (a file, or stdin when omitted or "-") is one command per line,
+ * '#' starts a comment. Times are in milliseconds and may have decimals.
+ *
+ *   at <ms>                    move the cursor to an absolute time
+ *   wait <ms>                  move the cursor forward
+ *   edge <gpio> <0|1>          drive a pin at the cursor
+ *   hook off | hook on         lift or replace the handset
+ *   dial <digit> [pps] [brk%]  a full pulse train, 10 pps 60% break default
+ *   line <n>                   hook and dial drive line n from here, 0 first;
+ *                              lines 1-3 need their pins set with --config
+ *
+ * Every HID report the firmware would send is printed with its timestamp.
+ * With --sleep the loop runs like the firmware's: one pass, then straight
+ * to the next task deadline or trace edge, and the number of passes is
+ * reported at the end. Reports land at the same times as with a fixed
+ * step, only without the step rounding. --stats prints the latency
+ * histograms and counters the device would report (stats.h) at the end.
+ * --config stores a value in the simulated config store before the run,
+ * FIELD being its index in ConfigField (config.h); --macro-gap-ms is
+ * short for the macro gap field.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "hal_sim.h"
+#include "dialer.h"
+#include "hid_queue.h"
+#include "config.h"
+#include "keyboard.h"
+#include "stats.h"
+#include "timers.h"
+#include "usb_descriptors.h"
+
+struct SimEvent
+{
+    uint64_t time_us;
+    uint8_t  pin;
+    bool     level;
+};
+
+static bool parse_trace(FILE *f, std::vector<SimEvent> &events)
+{
+    char     line[256];
+    int      line_no = 0;
+    double   cursor_ms = 0;
+    uint8_t  pulse_pin, hangup_pin;
+
+    config_line_pins(0, &pulse_pin, &hangup_pin);
+
+    while (fgets(line, sizeof(line), f))
+    {
+        ++line_no;
+        char *hash = strchr(line, '#');
+        if (hash) *hash = 0;
+
+        char   cmd[16] = "", arg[16] = "";
+        double a = 0, b = 0, c = 0;
+        int n = sscanf(line, "%15s", cmd);
+        if (n <= 0) continue;
+
+        auto at = [&](double ms) { return (uint64_t)(ms * 1000.0 + 0.5); };
+
+        if (!strcmp(cmd, "at") && sscanf(line, "%*s %lf", &a) == 1)
+        {
+            cursor_ms = a;
+        }
+        else if (!strcmp(cmd, "wait") && sscanf(line, "%*s %lf", &a) == 1)
+        {
+            cursor_ms += a;
+        }
+        else if (!strcmp(cmd, "edge") && sscanf(line, "%*s %lf %lf", &a, &b) == 2)
+        {
+            events.push_back({ at(cursor_ms), (uint8_t)a, b != 0 });
+        }
+        else if (!strcmp(cmd, "line") && sscanf(line, "%*s %lf", &a) == 1 &&
+                 a >= 0 && a < DIAL_LINES && config_line_pins((uint8_t)a, &pulse_pin, &hangup_pin))
+        {
+            // hook and dial use the line's pins from here on
+        }
+        else if (!strcmp(cmd, "hook") && sscanf(line, "%*s %15s", arg) == 1 &&
+                 (!strcmp(arg, "on") || !strcmp(arg, "off")))
+        {
+            // on-hook pulls the hook pin HIGH
+            events.push_back({ at(cursor_ms), hangup_pin, !strcmp(arg, "on") });
+        }
+        else if (!strcmp(cmd, "dial") && (n = sscanf(line, "%*s %lf %lf %lf", &a, &b, &c)) >= 1 &&
+                 a >= 0 && a <= 9)
+        {
+            double pps    = n >= 2 ? b : 10;
+            double brk    = n >= 3 ? c : 60;
+            int    pulses = a == 0 ? 10 : (int)a;
+            double period = 1000.0 / pps;
+
+            for (int i = 0; i < pulses; i++)
+            {
+                events.push_back({ at(cursor_ms), pulse_pin, false });
+                events.push_back({ at(cursor_ms + period * brk / 100.0), pulse_pin, true });
+                cursor_ms += period;
+            }
+        }
+        else
+        {
+            fprintf(stderr, "line %d: cannot parse: %s\n", line_no, line);
+            return false;
+        }
+    }
+
+    std::stable_sort(events.begin(), events.end(),
+                     [](const SimEvent &x, const SimEvent &y) { return x.time_us < y.time_us; });
+    return true;
+}
+
+static void print_report(const SimReport &r)
+{
+    if (r.report_id == REPORT_ID_TELEPHONY ||
+        (r.report_id >= REPORT_ID_TELEPHONY_LINE1 && r.report_id <= REPORT_ID_TELEPHONY_LINE3))
+    {
+        printf("%12.3f ms  id=%u phone=%02x\n", r.time_us / 1000.0, r.report_id, r.buttons);
+        return;
+    }
+    printf("%12.3f ms  id=%u mod=%02x keys=", r.time_us / 1000.0, r.report_id, r.modifier);
+    for (int i = 0; i < 6; i++)
+    {
+        printf("%02x%s", r.keycode[i], i < 5 ? " " : "\n");
+    }
+}
+
+static void print_stats(void)
+{
+    static const char *const latency_names[LATENCY_COUNT]  = { "digit", "hook", "hid-ep", "mic" };
+    static const char *const counter_names[COUNTER_COUNT]  = {
+        "pulse bounces", "hook bounces", "bad digits", "noise pulses", "odd pulses", "edge drops",
+        "event drops", "hid drops", "mic underruns", "mic overruns", "spk underruns", "spk overruns"
+    };
+
+    for (int id = 0; id < LATENCY_COUNT; id++)
+    {
+        LatencyHistogram h;
+        stats_read_latency((LatencyId)id, &h);
+        printf("latency %-7s n=%u max=%.3f ms mean=%.3f ms\n", latency_names[id], h.count,
+               h.max_us / 1000.0, h.count ? h.sum_us / 1000.0 / h.count : 0.0);
+        for (int b = 0; b < STATS_BUCKETS; b++)
+        {
+            if (h.buckets[b])
+            {
+                printf("    < %9.3f ms  %u\n", (64u << b) / 1000.0, h.buckets[b]);
+            }
+        }
+    }
+
+    StatsCounters c;
+    stats_read_counters(&c);
+    for (int id = 0; id < COUNTER_COUNT; id++)
+    {
+        printf("%-14s %u\n", counter_names[id], c.counters[id]);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t    step_us = 100;
+    bool        sleep   = false;
+    bool        stats   = false;
+    uint32_t    tail_ms = 3000;
+    const char *path    = "-";
+
+    config_load(KeyBoard::key_mask);
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--step-us") && i + 1 < argc)
+            step_us = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--sleep"))
+            sleep = true;
+        else if (!strcmp(argv[i], "--stats"))
+            stats = true;
+        else if (!strcmp(argv[i], "--hid-interval-us") && i + 1 < argc)
+            sim_set_hid_interval_us((uint32_t)atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--macro-gap-ms") && i + 1 < argc)
+            config_set(CONFIG_MACRO_GAP_MS, (uint32_t)atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--config") && i + 1 < argc)
+        {
+            char          *end;
+            unsigned long  field = strtoul(argv[++i], &end, 10);
+            unsigned long  value = *end == '=' ? strtoul(end + 1, &end, 0) : 0;
+            if (*end || field >= CONFIG_FIELD_COUNT ||
+                !config_set((ConfigField)field, (uint32_t)value))
+            {
+                fprintf(stderr, "bad or rejected --config %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "--tail-ms") && i + 1 < argc)
+            tail_ms = (uint32_t)atoi(argv[++i]);
+        else
+            path = argv[i];
+    }
+    if (step_us == 0) step_us = 1;
+
+    FILE *f = strcmp(path, "-") ? fopen(path, "r") : stdin;
+    if (!f)
+    {
+        perror(path);
+        return 1;
+    }
+
+    std::vector<SimEvent> events;
+    bool ok = parse_trace(f, events);
+    if (f != stdin) fclose(f);
+    if (!ok) return 1;
+
+    sim_set_time_us(0);
+    dialer_init();
+
+    uint64_t end_us = (events.empty() ? 0 : events.back().time_us) + tail_ms * 1000ull;
+    size_t   next   = 0;
+    size_t   shown  = 0;
+    uint32_t reboots = 0;
+    uint32_t passes  = 0;
+
+    // one main-loop pass every step_us, or per wake-up with --sleep;
+    // edges land at their exact time
+    for (uint64_t t = 0; t <= end_us; )
+    {
+        while (next < events.size() && events[next].time_us <= t)
+        {
+            sim_set_time_us(events[next].time_us);
+            sim_set_pin(events[next].pin, events[next].level);
+            ++next;
+        }
+        sim_set_time_us(t);
+
+        // core 1
+        edge_task();
+        timers_run(1, t);
+
+        // core 0
+        sim_usb_task();
+        dial_event_task();
+        hid_task();
+        hid_queue_task();
+        timers_run(0, t);
+
+        for (; shown < sim_reports().size(); ++shown)
+        {
+            print_report(sim_reports()[shown]);
+        }
+        if (sim_reboots() != reboots)
+        {
+            reboots = sim_reboots();
+            printf("%12.3f ms  reboot to bootloader\n", t / 1000.0);
+        }
+        ++passes;
+
+        if (!sleep)
+        {
+            t += step_us;
+            continue;
+        }
+        uint64_t wake = std::min({ timers_next_us(0), timers_next_us(1),
+                                   sim_usb_next_deadline_us(), end_us + 1 });
+        if (next < events.size())
+        {
+            wake = std::min(wake, events[next].time_us);
+        }
+        t = std::max(wake, t + 1);
+    }
+
+    if (sleep)
+    {
+        printf("%u loop passes in %.3f ms\n", passes, end_us / 1000.0);
+    }
+    if (stats)
+    {
+        print_stats();
+    }
+
+    return 0;
+}
@@ -0,0 +1,260 @@
+/**
+ * @file hal_sim.cpp
+ * @brief hal.h on a simulated clock, simulated pins and a recording HID sink
+ */
+
+#include <string.h>
+
+#include "hal.h"
+#include "hal_sim.h"
+#include "dialer.h"
+#include "hid_queue.h"
+
+#define NUM_PINS 30
+
+static uint64_t now_us = 0;
+
+// every pin idles HIGH, as with the pull-ups on the real board
+static uint32_t pin_levels = (1u << NUM_PINS) - 1;
+static uint32_t irq_pins   = 0;
+
+static uint32_t hid_interval_us = 5000;
+static uint64_t hid_busy_until  = 0;
+static bool     hid_in_flight   = false;
+static bool     suspended       = false;
+
+static std::vector<SimReport> reports;
+static uint32_t reboots = 0;
+static uint32_t wakeups = 0;
+static uint32_t macros[DIAL_LINES];
+static uint64_t macro_at_us[DIAL_LINES];
+
+// starts out erased, like a freshly flashed board
+static uint8_t flash[HAL_FLASH_SECTORS * HAL_FLASH_SECTOR_SIZE];
+static bool    flash_ready = false;
+
+//--------------------------------------------------------------------+
+// Simulator side
+//--------------------------------------------------------------------+
+
+void sim_set_time_us(uint64_t time_us)
+{
+    now_us = time_us;
+}
+
+uint64_t sim_time_us(void)
+{
+    return now_us;
+}
+
+void sim_set_pin(uint8_t pin, bool level)
+{
+    uint32_t mask = 1u << pin;
+    if (((pin_levels & mask) != 0) == level)
+    {
+        return;
+    }
+    pin_levels ^= mask;
+
+    if (irq_pins & mask)
+    {
+        edge_capture(pin, level, now_us);
+    }
+}
+
+void sim_set_hid_interval_us(uint32_t interval_us)
+{
+    hid_interval_us = interval_us;
+}
+
+void sim_usb_task(void)
+{
+    // the host has polled the endpoint, as tud_hid_report_complete_cb()
+    if (hid_in_flight && now_us >= hid_busy_until)
+    {
+        hid_in_flight = false;
+        hid_queue_report_complete();
+    }
+}
+
+uint64_t sim_usb_next_deadline_us(void)
+{
+    return hid_in_flight ? hid_busy_until : UINT64_MAX;
+}
+
+void sim_set_suspended(bool s)
+{
+    suspended = s;
+}
+
+const std::vector<SimReport> &sim_reports(void)
+{
+    return reports;
+}
+
+void sim_clear_reports(void)
+{
+    reports.clear();
+}
+
+uint32_t sim_reboots(void)
+{
+    return reboots;
+}
+
+uint32_t sim_remote_wakeups(void)
+{
+    return wakeups;
+}
+
+uint32_t sim_macros_started(uint8_t line, uint64_t *last_us)
+{
+    *last_us = macro_at_us[line];
+    return macros[line];
+}
+
+//--------------------------------------------------------------------+
+// hal.h
+//--------------------------------------------------------------------+
+
+uint64_t hal_time_us(void)
+{
+    return now_us;
+}
+
+void hal_gpio_inputs_pullup(uint32_t pins)
+{
+    (void)pins;
+}
+
+uint32_t hal_gpio_get_all(void)
+{
+    return pin_levels;
+}
+
+void hal_gpio_enable_edge_irqs(uint32_t pins)
+{
+    irq_pins |= pins;
+}
+
+void hal_gpio_enable_edge_timers(uint32_t pins)
+{
+    irq_pins |= pins;   // simulated edges carry their exact time anyway
+}
+
+bool hal_hid_ready(void)
+{
+    return !suspended && now_us >= hid_busy_until;
+}
+
+bool hal_hid_keyboard_report(uint8_t report_id, uint8_t modifier, const uint8_t keycode[6])
+{
+    if (!hal_hid_ready())
+    {
+        return false;
+    }
+
+    SimReport r;
+    r.time_us   = now_us;
+    r.report_id = report_id;
+    r.modifier  = modifier;
+    r.buttons   = 0;
+    if (keycode)
+    {
+        memcpy(r.keycode, keycode, sizeof(r.keycode));
+    }
+    else
+    {
+        memset(r.keycode, 0, sizeof(r.keycode));
+    }
+    reports.push_back(r);
+
+    hid_busy_until = now_us + hid_interval_us;
+    hid_in_flight  = true;
+    return true;
+}
+
+bool hal_hid_phone_report(uint8_t report_id, uint8_t buttons)
+{
+    if (!hal_hid_ready())
+    {
+        return false;
+    }
+
+    SimReport r = { now_us, report_id, 0, {0}, buttons };
+    reports.push_back(r);
+
+    hid_busy_until = now_us + hid_interval_us;
+    hid_in_flight  = true;
+    return true;
+}
+
+bool hal_usb_suspended(void)
+{
+    return suspended;
+}
+
+void hal_usb_remote_wakeup(void)
+{
+    ++wakeups;
+}
+
+void hal_macro_started(uint8_t line)
+{
+    macros[line]++;
+    macro_at_us[line] = now_us;
+}
+
+void hal_handset_off_hook(bool off_hook)
+{
+    (void)off_hook;     // no audio in the simulator
+}
+
+void hal_handset_digit(uint8_t digit)
+{
+    (void)digit;        // no audio in the simulator
+}
+
+void hal_reboot_to_bootloader(void)
+{
+    ++reboots;
+}
+
+void hal_wake_other_core(void)
+{
+    // both "cores" run in the one simulator loop
+}
+
+const uint8_t *hal_flash_store(void)
+{
+    if (!flash_ready)
+    {
+        memset(flash, 0xFF, sizeof(flash));
+        flash_ready = true;
+    }
+    return flash;
+}
+
+void hal_flash_erase(uint32_t sector)
+{
+    hal_flash_store();
+    memset(flash + sector * HAL_FLASH_SECTOR_SIZE, 0xFF, HAL_FLASH_SECTOR_SIZE);
+}
+
+void hal_flash_program(uint32_t offset, const uint8_t page[HAL_FLASH_PAGE_SIZE])
+{
+    hal_flash_store();
+    for (uint32_t i = 0; i < HAL_FLASH_PAGE_SIZE; i++)
+    {
+        flash[offset + i] &= page[i];   // programming only clears bits
+    }
+}
+
+void hal_flash_lock(void)
+{
+    // one thread, nothing to serialise
+}
+
+void hal_flash_unlock(void)
+{
+}
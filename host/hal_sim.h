@@ -0,0 +1,48 @@
+/**
+ * @file hal_sim.h
+ * @brief controls for the simulated hardware behind hal.h
+ *
+ * The clock only moves when the simulator moves it, pins only change when
+ * the simulator sets them, and every HID report is recorded instead of sent.
+ */
+
+#ifndef HAL_SIM_H
+#define HAL_SIM_H
+
+#include <stdint.h>
+#include <vector>
+
+struct SimReport
+{
+	uint64_t time_us;
+	uint8_t  report_id;
+	uint8_t  modifier;
+	uint8_t  keycode[6];
+	uint8_t  buttons;	// telephony reports
+};
+
+// ---------------  CLOCK ---------------------------
+void     sim_set_time_us(uint64_t time_us);
+uint64_t sim_time_us(void);
+
+// ---------------  GPIO ----------------------------
+// Drives a pin; a level change on an IRQ pin reaches edge_capture()
+void sim_set_pin(uint8_t pin, bool level);
+
+// ---------------  USB -----------------------------
+// The endpoint stays busy this long after each report (bInterval)
+void sim_set_hid_interval_us(uint32_t interval_us);
+// Completes the report in flight once its interval is over, like tud_task()
+void sim_usb_task(void);
+// When sim_usb_task() next has a report to complete, UINT64_MAX if none
+uint64_t sim_usb_next_deadline_us(void);
+void sim_set_suspended(bool suspended);
+
+const std::vector<SimReport> &sim_reports(void);
+void     sim_clear_reports(void);
+uint32_t sim_reboots(void);
+uint32_t sim_remote_wakeups(void);
+// How many macros macro_run() accepted for line, and when the last one was
+uint32_t sim_macros_started(uint8_t line, uint64_t *last_us);
+
+#endif /* HAL_SIM_H */
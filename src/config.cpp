@@ -0,0 +1,361 @@
+/**
+ * @file config.cpp
+ * @brief the flash log behind config, see config.h
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "hal.h"
+#include "config.h"
+#include "debounce.h"
+#include "dial_timing.h"
+#include "dialer.h"
+#include "keyboard.h"
+#include "speaker.h"
+
+#define SEQUENCE_KEY      0x5EC0        // key of a sector's first record
+#define SLOTS_PER_SECTOR  (HAL_FLASH_SECTOR_SIZE / sizeof(Record))
+#define NO_SECTOR         0xFFFFFFFFu
+
+struct Record
+{
+    uint16_t key;       // ConfigField + 1, or SEQUENCE_KEY
+    uint16_t check;     // ~(key ^ value halves), rejects torn writes
+    uint32_t value;
+};
+
+static_assert(HAL_FLASH_PAGE_SIZE % sizeof(Record) == 0, "records straddle pages");
+static_assert(CONFIG_FIELD_COUNT + 1 <= HAL_FLASH_PAGE_SIZE / sizeof(Record),
+              "a compacted sector must fit in its first page");
+
+struct FieldRule
+{
+    uint32_t initial;
+    uint32_t min;
+    uint32_t max;
+};
+
+static const FieldRule rules[CONFIG_FIELD_COUNT] = {
+    { PULSE_PIN,                         0, 29 },
+    { HANGUP_PIN,                        0, 29 },
+    { PULSE_DEBOUNCE_MS,                 1, Debouncer::MAX_TICKS },
+    { HANGUP_DEBOUNCE_MS,                1, Debouncer::MAX_TICKS },
+    { KEY_DEBOUNCE_MS,                   1, Debouncer::MAX_TICKS },
+    { DialTiming::TIMEOUT_MAX_US / 1000, DialTiming::TIMEOUT_MIN_US / 1000, 2000 },
+    { 0xFFFF1234u,                       0, UINT32_MAX },   // see boot_code_valid()
+    { 0,                                 0, 1 },
+    { 20,                                1, 255 },
+    { 0,                                 0, UINT32_MAX },   // DialTiming::load() checks these
+    { 0,                                 0, UINT32_MAX },
+    { 0xFFFFFFFFu,                       0, UINT32_MAX },   // see line_pins_valid()
+    { 0xFFFFFFFFu,                       0, UINT32_MAX },
+    { SPEAKER_DEPTH_MS,                  1, SPEAKER_DEPTH_MAX_MS },
+};
+
+static_assert(PULSE_DEBOUNCE_MS >= 1 && PULSE_DEBOUNCE_MS <= Debouncer::MAX_TICKS &&
+              HANGUP_DEBOUNCE_MS >= 1 && HANGUP_DEBOUNCE_MS <= Debouncer::MAX_TICKS &&
+              KEY_DEBOUNCE_MS >= 1 && KEY_DEBOUNCE_MS <= Debouncer::MAX_TICKS,
+              "debounce times must fit the tick counters");
+
+Config config;
+
+static uint32_t reserved  = 0;          // pins the dial and hook can't take
+static uint32_t stored    = 0;          // fields with a record in the log
+static uint32_t active    = NO_SECTOR;  // sector being appended to
+static uint32_t sequence  = 0;          // its sequence number
+static uint32_t next_slot = SLOTS_PER_SECTOR;
+
+static uint32_t *fields(Config &c = config)
+{
+    return reinterpret_cast<uint32_t *>(&c);
+}
+
+static const uint32_t *fields(const Config &c)
+{
+    return reinterpret_cast<const uint32_t *>(&c);
+}
+
+static uint16_t record_check(uint16_t key, uint32_t value)
+{
+    return (uint16_t)~(key ^ value ^ (value >> 16));
+}
+
+static const Record *slot(uint32_t sector, uint32_t index)
+{
+    return reinterpret_cast<const Record *>(hal_flash_store() + sector * HAL_FLASH_SECTOR_SIZE) + index;
+}
+
+static bool erased(const Record *r)
+{
+    return r->key == 0xFFFF && r->check == 0xFFFF && r->value == 0xFFFFFFFFu;
+}
+
+static bool intact(const Record *r)
+{
+    return r->check == record_check(r->key, r->value);
+}
+
+// digits 0-9 from the lowest nibble up, then only 0xF
+static bool boot_code_valid(uint32_t code)
+{
+    uint32_t shift = 0;
+    while (shift < 32 && ((code >> shift) & 0xF) <= 9)
+    {
+        shift += 4;
+    }
+    return shift == 32 || (code >> shift) == (0xFFFFFFFFu >> shift);
+}
+
+// a GPIO or CONFIG_NO_PIN per line 1-3, the top byte unused
+static bool line_pins_valid(uint32_t pins)
+{
+    for (uint32_t line = 1; line < 4; line++, pins >>= 8)
+    {
+        if ((pins & 0xFF) > 29 && (pins & 0xFF) != CONFIG_NO_PIN)
+        {
+            return false;
+        }
+    }
+    return pins == CONFIG_NO_PIN;
+}
+
+static bool valid(ConfigField field, uint32_t value)
+{
+    if (value < rules[field].min || value > rules[field].max)
+    {
+        return false;
+    }
+    if (field == CONFIG_LINE_PULSE_PINS || field == CONFIG_LINE_HANGUP_PINS)
+    {
+        return line_pins_valid(value);
+    }
+    return field != CONFIG_BOOT_CODE || boot_code_valid(value);
+}
+
+static bool line_pins(const Config &c, uint8_t line, uint8_t *pulse, uint8_t *hangup)
+{
+    if (line >= DIAL_LINES)
+    {
+        return false;
+    }
+    if (line == 0)
+    {
+        *pulse  = (uint8_t)c.pulse_pin;
+        *hangup = (uint8_t)c.hangup_pin;
+        return true;
+    }
+    *pulse  = (uint8_t)(c.line_pulse_pins >> (line - 1) * 8);
+    *hangup = (uint8_t)(c.line_hangup_pins >> (line - 1) * 8);
+    return *pulse != CONFIG_NO_PIN && *hangup != CONFIG_NO_PIN;
+}
+
+// no two fitted lines share a pin, and none takes a reserved one
+static bool lines_valid(const Config &c)
+{
+    uint32_t used = reserved;
+    for (uint8_t line = 0; line < DIAL_LINES; line++)
+    {
+        uint8_t pulse, hangup;
+        if (!line_pins(c, line, &pulse, &hangup))
+        {
+            continue;
+        }
+        uint32_t pins = 1u << pulse | 1u << hangup;
+        if (pulse == hangup || (used & pins))
+        {
+            return false;
+        }
+        used |= pins;
+    }
+    return true;
+}
+
+static bool pin_field(ConfigField field)
+{
+    return field == CONFIG_PULSE_PIN || field == CONFIG_HANGUP_PIN ||
+           field == CONFIG_LINE_PULSE_PINS || field == CONFIG_LINE_HANGUP_PINS;
+}
+
+// Program one record into the active sector. The rest of its page is
+// programmed with what it already holds, which leaves it as it is.
+static void append(uint16_t key, uint32_t value)
+{
+    static uint8_t page[HAL_FLASH_PAGE_SIZE];
+
+    uint32_t offset = active * HAL_FLASH_SECTOR_SIZE + next_slot * sizeof(Record);
+    uint32_t base   = offset & ~(uint32_t)(HAL_FLASH_PAGE_SIZE - 1);
+    Record   r      = { key, record_check(key, value), value };
+
+    memcpy(page, hal_flash_store() + base, sizeof(page));
+    memcpy(page + (offset - base), &r, sizeof(r));
+    hal_flash_program(base, page);
+    next_slot++;
+}
+
+// Copy the stored fields into the next sector. Its sequence record goes
+// in last, and only then does it outrank the old one.
+static void compact(void)
+{
+    static Record page[HAL_FLASH_PAGE_SIZE / sizeof(Record)];
+
+    uint32_t sector = active == NO_SECTOR ? 0 : (active + 1) % HAL_FLASH_SECTORS;
+    uint32_t count  = 1;
+
+    memset(page, 0xFF, sizeof(page));
+    for (uint32_t f = 0; f < CONFIG_FIELD_COUNT; f++)
+    {
+        if (stored & (1u << f))
+        {
+            uint16_t key  = (uint16_t)(f + 1);
+            page[count++] = { key, record_check(key, fields()[f]), fields()[f] };
+        }
+    }
+
+    hal_flash_erase(sector);
+    hal_flash_program(sector * HAL_FLASH_SECTOR_SIZE, (const uint8_t *)page);
+    sequence++;
+    page[0] = { SEQUENCE_KEY, record_check(SEQUENCE_KEY, sequence), sequence };
+    hal_flash_program(sector * HAL_FLASH_SECTOR_SIZE, (const uint8_t *)page);
+
+    active    = sector;
+    next_slot = count;
+}
+
+void config_load(uint32_t reserved_pins)
+{
+    reserved  = reserved_pins;
+    stored    = 0;
+    active    = NO_SECTOR;
+    sequence  = 0;
+    next_slot = SLOTS_PER_SECTOR;
+    for (uint32_t f = 0; f < CONFIG_FIELD_COUNT; f++)
+    {
+        fields()[f] = rules[f].initial;
+    }
+
+    // the current sector is the one with the newest sequence record
+    for (uint32_t s = 0; s < HAL_FLASH_SECTORS; s++)
+    {
+        const Record *r = slot(s, 0);
+        if (r->key == SEQUENCE_KEY && intact(r) &&
+            (active == NO_SECTOR || (int32_t)(r->value - sequence) > 0))
+        {
+            active   = s;
+            sequence = r->value;
+        }
+    }
+    if (active == NO_SECTOR)
+    {
+        return;     // blank: defaults, and the first config_set() formats
+    }
+
+    // later records of a field override earlier ones
+    for (next_slot = 1; next_slot < SLOTS_PER_SECTOR; next_slot++)
+    {
+        const Record *r = slot(active, next_slot);
+        if (erased(r))
+        {
+            break;
+        }
+        uint32_t f = r->key - 1u;
+        if (intact(r) && f < CONFIG_FIELD_COUNT && valid((ConfigField)f, r->value))
+        {
+            fields()[f] = r->value;
+            stored     |= 1u << f;
+        }
+    }
+
+    // a new key map can take a pin a dial or hook was moved to: drop the
+    // extra lines first, then move line 0 back to its default pins
+    if (!lines_valid(config))
+    {
+        config.line_pulse_pins  = rules[CONFIG_LINE_PULSE_PINS].initial;
+        config.line_hangup_pins = rules[CONFIG_LINE_HANGUP_PINS].initial;
+    }
+    if (!lines_valid(config))
+    {
+        config.pulse_pin  = rules[CONFIG_PULSE_PIN].initial;
+        config.hangup_pin = rules[CONFIG_HANGUP_PIN].initial;
+    }
+}
+
+bool config_line_pins(uint8_t line, uint8_t *pulse_pin, uint8_t *hangup_pin)
+{
+    return line_pins(config, line, pulse_pin, hangup_pin);
+}
+
+// Record a changed field; the caller holds the flash lock
+static void store(ConfigField field, uint32_t value)
+{
+    if (fields()[field] == value)
+    {
+        return;
+    }
+    fields()[field] = value;
+    stored         |= 1u << field;
+    if (next_slot < SLOTS_PER_SECTOR)
+    {
+        append((uint16_t)(field + 1), value);
+    }
+    else
+    {
+        compact();      // carries the new value over with the rest
+    }
+}
+
+bool config_set(ConfigField field, uint32_t value)
+{
+    if (field >= CONFIG_FIELD_COUNT || !valid(field, value))
+    {
+        return false;
+    }
+
+    hal_flash_lock();
+    bool ok = true;
+    if (pin_field(field))
+    {
+        Config next = config;
+        fields(next)[field] = value;
+        ok = lines_valid(next);
+    }
+    if (ok)
+    {
+        store(field, value);
+    }
+    hal_flash_unlock();
+    return ok;
+}
+
+// the dial calibration core 1 learns and saves on its own
+static bool learned_field(ConfigField field)
+{
+    return field == CONFIG_DIAL_PERIOD_US || field == CONFIG_DIAL_BREAK_US;
+}
+
+void config_set_all(const Config &incoming)
+{
+    hal_flash_lock();
+    // the snapshot is taken under the lock, so a calibration saved after
+    // the host read the report is kept; only a 0, to relearn, clears it
+    Config next = config;
+    for (uint32_t f = 0; f < CONFIG_FIELD_COUNT; f++)
+    {
+        uint32_t value = fields(incoming)[f];
+        if (valid((ConfigField)f, value) && (!learned_field((ConfigField)f) || value == 0))
+        {
+            fields(next)[f] = value;
+        }
+    }
+
+    // the pins are judged as a set, so a report can swap two of them
+    bool pins_ok = lines_valid(next);
+    for (uint32_t f = 0; f < CONFIG_FIELD_COUNT; f++)
+    {
+        if (pins_ok || !pin_field((ConfigField)f))
+        {
+            store((ConfigField)f, fields(next)[f]);
+        }
+    }
+    hal_flash_unlock();
+}
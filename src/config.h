@@ -0,0 +1,87 @@
+/**
+ * @file config.h
+ * @brief per-unit settings, kept in a wear-levelled log in flash
+ *
+ * The settings live in one RAM struct, config, that the rest of the code
+ * reads directly. config_load() fills it at boot with a single scan of the
+ * log; config_set() appends a record for each change. Feature report 11
+ * reads and writes the whole struct.
+ *
+ * The log takes the last HAL_FLASH_SECTORS sectors of flash. A sector
+ * starts with a sequence record and fills with 8-byte records (key, check,
+ * value), one per change; the newest record of a key wins. A full sector
+ * is compacted into the next one, whose sequence record is written last,
+ * so after a power loss at any point one sector is complete and current.
+ * A record torn mid-write fails its check and is skipped.
+ */
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <stdint.h>
+
+enum ConfigField
+{
+    CONFIG_PULSE_PIN,           // dial pulse contact, at the next reset
+    CONFIG_HANGUP_PIN,          // hook switch, at the next reset
+    CONFIG_PULSE_DEBOUNCE_MS,   // 1-63, at the next reset
+    CONFIG_HANGUP_DEBOUNCE_MS,  // 1-63, at the next reset
+    CONFIG_KEY_DEBOUNCE_MS,     // 1-63, at the next reset
+    CONFIG_DIGIT_TIMEOUT_MS,    // cap on the learned end-of-digit silence
+    CONFIG_BOOT_CODE,           // digits that reboot to the bootloader
+    CONFIG_HANG_UP_MACRO,       // 1: hanging up also types MACRO_HANG_UP
+    CONFIG_MACRO_GAP_MS,        // pause between macro steps
+    CONFIG_DIAL_PERIOD_US,      // learned dial calibration, 0 until saved
+    CONFIG_DIAL_BREAK_US,
+    CONFIG_LINE_PULSE_PINS,     // lines 1-3, a byte each from the lowest, at the next reset
+    CONFIG_LINE_HANGUP_PINS,    // CONFIG_NO_PIN for a line that isn't fitted
+    CONFIG_SPEAKER_DEPTH_MS,    // earpiece jitter buffer, at the next reset
+    CONFIG_FIELD_COUNT
+};
+
+// One uint32_t per ConfigField, in that order; also the report layout
+struct Config
+{
+    uint32_t pulse_pin;
+    uint32_t hangup_pin;
+    uint32_t pulse_debounce_ms;
+    uint32_t hangup_debounce_ms;
+    uint32_t key_debounce_ms;
+    uint32_t digit_timeout_ms;
+    uint32_t boot_code;         // one digit per nibble, last dialled lowest,
+                                // 0xF above the first digit; 0xFFFFFFFF is off
+    uint32_t hang_up_macro;
+    uint32_t macro_gap_ms;
+    uint32_t dial_period_us;
+    uint32_t dial_break_us;
+    uint32_t line_pulse_pins;
+    uint32_t line_hangup_pins;
+    uint32_t speaker_depth_ms;
+};
+
+#define CONFIG_NO_PIN 0xFF
+
+static_assert(sizeof(Config) == CONFIG_FIELD_COUNT * sizeof(uint32_t), "one word per field");
+
+// Read-only outside config.cpp; change it through config_set()
+extern Config config;
+
+// At boot, before core 1 starts. reserved_pins are the pins the dials and
+// hook switches may not move to.
+void config_load(uint32_t reserved_pins);
+
+// The pins of line (below DIAL_LINES, usb_descriptors.h); false if the line
+// isn't fitted. Line 0 always is, the others once both their pins are set.
+bool config_line_pins(uint8_t line, uint8_t *pulse_pin, uint8_t *hangup_pin);
+
+// Store a new value, from either core. Returns false, and changes nothing,
+// for a value out of range or a pin already in use.
+bool config_set(ConfigField field, uint32_t value);
+
+// Store every field of a whole struct, from feature report 11. A bad value
+// leaves its field as it was. The pins are checked together, so one report
+// can swap two pins; if they clash, none of the pin fields change. The
+// learned dial calibration is kept unless the report zeroes it.
+void config_set_all(const Config &incoming);
+
+#endif /* CONFIG_H */
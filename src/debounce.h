@@ -0,0 +1,120 @@
+/**
+ * @file debounce.h
+ * @brief debounce every GPIO at once with bit-sliced vertical counters
+ *
+ * Each watched pin has a small counter of ticks spent away from its
+ * debounced level. The counters are stored sideways: plane k holds bit k
+ * of all 32 counters, so one tick updates every pin with a handful of
+ * word-wide operations and no per-pin loop. A pin flips once its counter
+ * reaches the threshold set for it with watch(); the thresholds are
+ * stored as planes too and compared the same way.
+ *
+ * Sampling alone misses a bounce that starts and ends between two ticks,
+ * so an edge seen by interrupt can also restart a pin's count. A change
+ * is then only accepted after threshold whole ticks without any edge.
+ */
+
+#ifndef DEBOUNCE_H
+#define DEBOUNCE_H
+
+#include <stdint.h>
+
+class Debouncer
+{
+public:
+	static const uint32_t PLANES    = 6;
+	static const uint32_t MAX_TICKS = (1u << PLANES) - 1;
+
+private:
+	uint32_t count[PLANES] = {0};   // vertical tick counters
+	uint32_t limit[PLANES] = {0};   // per-pin thresholds, same layout
+	uint32_t watched   = 0;
+	uint32_t restarts  = 0;         // edges since the last tick
+	uint32_t unsettled = 0;         // away from the debounced level at the last tick
+
+	void clear(uint32_t pins)
+	{
+		for (uint32_t k = 0; k < PLANES; k++)
+		{
+			count[k] &= ~pins;
+		}
+	}
+
+	// ripple-carry add of 1 to the counters of pins
+	void increment(uint32_t pins)
+	{
+		uint32_t carry = pins;
+		for (uint32_t k = 0; k < PLANES && carry; k++)
+		{
+			uint32_t next = count[k] & carry;
+			count[k] ^= carry;
+			carry = next;
+		}
+	}
+
+	uint32_t at_limit() const
+	{
+		uint32_t equal = ~0u;
+		for (uint32_t k = 0; k < PLANES; k++)
+		{
+			equal &= ~(count[k] ^ limit[k]);
+		}
+		return equal;
+	}
+
+public:
+	uint32_t state = 0; // debounced levels of the watched pins
+	uint32_t rose  = 0; // went high at the last tick
+	uint32_t fell  = 0; // went low at the last tick
+
+	// pins must hold a new level for ticks (1 .. MAX_TICKS) ticks
+	void watch(uint32_t pins, uint32_t ticks)
+	{
+		for (uint32_t k = 0; k < PLANES; k++)
+		{
+			if (ticks & (1u << k)) limit[k] |= pins;
+			else                   limit[k] &= ~pins;
+		}
+		watched |= pins;
+	}
+
+	void reset(uint32_t levels)
+	{
+		clear(~0u);
+		state     = levels & watched;
+		rose      = fell = 0;
+		restarts  = unsettled = 0;
+	}
+
+	// an edge on pins: their count starts over at the next tick
+	void restart(uint32_t pins)
+	{
+		restarts |= pins & watched;
+	}
+
+	void tick(uint32_t levels)
+	{
+		uint32_t differ   = (levels ^ state) & watched;
+		uint32_t counting = differ & ~restarts;
+
+		clear(~counting);
+		increment(counting);
+
+		uint32_t done = counting & at_limit();
+		clear(done);
+		rose      = done & ~state;
+		fell      = done & state;
+		state    ^= done;
+		restarts  = 0;
+		unsettled = differ & ~done;
+	}
+
+	// false once every watched pin sits at its debounced level with no edge
+	// pending, when ticking would change nothing until the next edge
+	bool settling() const
+	{
+		return (restarts | unsettled) != 0;
+	}
+};
+
+#endif /* DEBOUNCE_H */
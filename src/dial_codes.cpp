@@ -0,0 +1,131 @@
+/**
+ * @file dial_codes.cpp
+ * @brief built-in dial codes and their compile-time trie, see dial_codes.h
+ */
+
+#include <stddef.h>
+
+#include "dial_codes.h"
+#include "usb_descriptors.h"
+
+struct DialCode
+{
+    const char    *digits;
+    DialCodeAction action;
+};
+
+// ===========================================================================
+// built-in dial codes; a code may also be the start of a longer one
+static constexpr DialCode codes[] = {
+    { "0001", DIAL_CODE_ANSWER  },
+    { "0002", DIAL_CODE_MUTE    },
+    { "0003", DIAL_CODE_HANG_UP },
+};
+// ===========================================================================
+
+#define CODE_COUNT (sizeof(codes) / sizeof(codes[0]))
+#define NO_MATCH   0xFF
+#define DEAD       0xFF     // off the trie, nothing matches until the next call
+
+// one state per digit of every code plus the root, fewer if codes share a prefix
+static constexpr size_t states_needed(void)
+{
+    size_t states = 1;
+    for (size_t c = 0; c < CODE_COUNT; c++)
+    {
+        for (const char *d = codes[c].digits; *d; d++)
+        {
+            states++;
+        }
+    }
+    return states;
+}
+
+#define STATES states_needed()
+
+static_assert(STATES < DEAD, "too many dial code digits for 8-bit states");
+static_assert(CODE_COUNT < NO_MATCH, "too many dial codes");
+
+struct Automaton
+{
+    uint8_t next[STATES][10];   // state after each digit, 0 is the root
+    uint8_t match[STATES];      // code ending in the state, or NO_MATCH
+    bool    valid;              // digits only, no empty or repeated code
+};
+
+static constexpr Automaton build(void)
+{
+    Automaton a = {};
+    size_t    used = 1;
+
+    a.valid = true;
+    for (size_t s = 0; s < STATES; s++)
+    {
+        a.match[s] = NO_MATCH;
+        for (size_t d = 0; d < 10; d++)
+        {
+            a.next[s][d] = DEAD;
+        }
+    }
+
+    // the trie; a digit no code goes on with leads off it
+    for (size_t c = 0; c < CODE_COUNT; c++)
+    {
+        size_t s = 0;
+        for (const char *d = codes[c].digits; *d; d++)
+        {
+            if (*d < '0' || *d > '9')
+            {
+                a.valid = false;
+                return a;
+            }
+            uint8_t &n = a.next[s][*d - '0'];
+            if (n == DEAD)
+            {
+                n = (uint8_t)used++;
+            }
+            s = n;
+        }
+        if (s == 0 || a.match[s] != NO_MATCH)
+        {
+            a.valid = false;
+        }
+        a.match[s] = (uint8_t)c;
+    }
+    return a;
+}
+
+static constexpr Automaton automaton = build();
+static_assert(automaton.valid, "dial codes must be distinct, non-empty and digits only");
+
+static uint8_t  state[DIAL_LINES];
+static uint64_t last_digit_us[DIAL_LINES];
+
+bool dial_codes_feed(uint8_t line, uint8_t digit, uint64_t time_us, DialCodeAction *action)
+{
+    uint8_t &s = state[line];
+
+    // the first digit of a call may come any time, the rest may not pause
+    if (digit > 9 || (s != 0 && time_us - last_digit_us[line] > DIAL_CODE_GAP_MS * 1000ull))
+    {
+        s = DEAD;
+    }
+    last_digit_us[line] = time_us;
+    if (s == DEAD)
+    {
+        return false;
+    }
+
+    s = automaton.next[s][digit];
+    if (s == DEAD || automaton.match[s] == NO_MATCH)
+    {
+        return false;
+    }
+    *action = codes[automaton.match[s]].action;
+    return true;
+}
+
+void dial_codes_reset(uint8_t line)
+{
+    state[line] = 0;
+}
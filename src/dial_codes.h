@@ -0,0 +1,42 @@
+/**
+ * @file dial_codes.h
+ * @brief dial codes that run macros or press Phone Mute, matched from the
+ *        first digit of a call
+ *
+ * The codes are a constexpr table in dial_codes.cpp. At compile time they
+ * are turned into a trie with a full next-state table for every digit, so
+ * feeding a digit is one table lookup however many codes there are, and the
+ * only RAM is the current state of each line. A code only matches as the
+ * first digits after lifting the handset: once a digit leads off every
+ * code, or the digits pause for more than DIAL_CODE_GAP_MS, nothing else
+ * matches until the next hook change. So a number or a menu choice that
+ * merely contains a code never sets it off.
+ *
+ * The bootloader code is per unit (config.boot_code) and is checked by the
+ * dialer on its own, under the same rules.
+ */
+
+#ifndef DIAL_CODES_H
+#define DIAL_CODES_H
+
+#include <stdint.h>
+
+#define DIAL_CODE_GAP_MS 5000
+
+// What a code does, on the line it was dialled on
+enum DialCodeAction
+{
+    DIAL_CODE_ANSWER,       // MACRO_ANSWER
+    DIAL_CODE_MUTE,         // Phone Mute on the telephony report, phone_mute_press()
+    DIAL_CODE_HANG_UP,      // MACRO_HANG_UP
+};
+
+// Feed one digit dialled on line (DIAL_DIGIT_INVALID ends matching for the
+// call). Returns true, with the action of the code that the call's digits
+// so far spell out, on a match. Each line matches on its own.
+bool dial_codes_feed(uint8_t line, uint8_t digit, uint64_t time_us, DialCodeAction *action);
+
+// Start matching afresh on line, on a hook change
+void dial_codes_reset(uint8_t line);
+
+#endif /* DIAL_CODES_H */
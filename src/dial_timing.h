@@ -0,0 +1,254 @@
+/**
+ * @file dial_timing.h
+ * @brief learn a rotary dial's pulse timing and derive the end-of-digit deadline
+ *
+ * The period is the time between the starts of two breaks inside one digit,
+ * the break width is how long the line stays LOW per pulse. Both are tracked
+ * with a 1/8 exponential average, so one odd pulse barely moves them.
+ * A digit is over once the line has been quiet for TIMEOUT_PERIODS_X2 / 2
+ * periods, clamped to TIMEOUT_MIN_US and a cap that defaults to
+ * TIMEOUT_MAX_US.
+ *
+ * Each pulse is also checked against that timing, from the microsecond
+ * edge times, once it is complete: at the next break or the end of the
+ * digit. A make far shorter than the learned one is chatter inside one
+ * break, and the breaks on both sides are judged as one. A break far
+ * shorter than the learned one is noise (relay clicks, a worn contact)
+ * and is not counted. A counted pulse's period is only known once the
+ * next real break has been judged, so a click inside a make neither
+ * shortens the learned period nor skews the pulse's ratio. A pulse whose
+ * break takes less than BREAK_MIN_PERCENT or more than BREAK_MAX_PERCENT
+ * of its period (for the last pulse of a digit, the one before it) is
+ * still counted but reported as odd through take_odd(), a sign of a dial
+ * that needs service. A pulse with no measured period, like the only
+ * pulse of a 1, isn't judged on its ratio: the learned period would call
+ * a dial that runs faster than its calibration odd.
+ */
+
+#ifndef DIAL_TIMING_H
+#define DIAL_TIMING_H
+
+#include <stdint.h>
+
+class DialTiming
+{
+public:
+	// ===========================================================================
+	static const uint32_t DEFAULT_PERIOD_US = 100000; // 10 pps
+	static const uint32_t DEFAULT_BREAK_US  = 60000;  // 60/40 break/make
+	static const uint32_t MIN_PERIOD_US     = 33000;  // ~30 pps
+	static const uint32_t MAX_PERIOD_US     = 200000; // 5 pps
+	static const uint32_t TIMEOUT_PERIODS_X2 = 3;     // 1.5 periods
+	static const uint32_t TIMEOUT_MIN_US    = 60000;
+	static const uint32_t TIMEOUT_MAX_US    = 400000; // default cap
+	static const uint32_t NOISE_BREAK_US    = 15000;  // shorter is noise even
+	static const uint32_t NOISE_MAKE_US     = 10000;  // before anything is learned
+	static const uint32_t BREAK_MIN_PERCENT = 50;     // in-spec break share of
+	static const uint32_t BREAK_MAX_PERCENT = 80;     // the period
+	// ===========================================================================
+
+	enum Pulse
+	{
+		PULSE_OK,       // count it
+		PULSE_NOISE,    // too short a break, don't count it
+		PULSE_NONE      // no pulse was completed
+	};
+
+private:
+	uint32_t period  = DEFAULT_PERIOD_US;
+	uint32_t brk     = DEFAULT_BREAK_US;
+	uint32_t timeout_max = TIMEOUT_MAX_US;
+	uint64_t last_break_us = 0;   // start of the previous break in this digit
+	uint64_t prev_break_us = 0;   // and the one before, if that was noise
+	uint32_t digit_period_us = 0; // last measured period in this digit, 0 for none
+	uint64_t last_make_us  = 0;   // end of it
+	uint64_t rest_us       = 0;   // last make after a break too long for noise
+	uint32_t held_break_us = 0;   // break of the last counted pulse, see settle()
+	bool     held          = false; // that pulse's ratio is still to be judged
+	uint8_t  odd           = 0;   // odd pulses found since take_odd()
+	bool     in_digit      = false;
+	bool     made          = false; // the last break has ended
+	bool     counted       = false; // a pulse of this digit was counted
+
+	static void average(uint32_t &avg, uint32_t sample)
+	{
+		avg = (uint32_t)((int32_t)avg + ((int32_t)sample - (int32_t)avg) / 8);
+	}
+
+	static bool plausible(uint32_t period_us)
+	{
+		return period_us >= MIN_PERIOD_US && period_us <= MAX_PERIOD_US;
+	}
+
+	// half the learned width, but never above the absolute floor, so a
+	// faster dial than the calibration is not mistaken for noise
+	static uint32_t noise_below(uint32_t learned_us, uint32_t floor_us)
+	{
+		return learned_us / 2 < floor_us ? learned_us / 2 : floor_us;
+	}
+
+	// The pulse that ends at last_break_us: noise, or a real one that
+	// becomes the held pulse. Only then is the period of the pulse held
+	// before it known, from the start of its break to this one.
+	Pulse judge()
+	{
+		uint32_t sample = (uint32_t)(last_make_us - last_break_us);
+		if (sample < noise_below(brk, NOISE_BREAK_US))
+		{
+			// noise ahead of the first pulse doesn't start the period either
+			in_digit      = counted;
+			last_break_us = prev_break_us;
+			return PULSE_NOISE;
+		}
+
+		if (held)
+		{
+			uint32_t pulse_us = (uint32_t)(last_break_us - prev_break_us);
+			if (plausible(pulse_us))
+			{
+				average(period, pulse_us);
+				++samples;
+				digit_period_us = pulse_us;
+			}
+			settle(plausible(pulse_us) ? pulse_us : digit_period_us);
+		}
+
+		counted = true;
+		if (sample < period)
+		{
+			average(brk, sample);
+		}
+		held_break_us = sample;
+		held          = true;
+		return PULSE_OK;
+	}
+
+	// judge the held pulse's break against pulse_us, its measured period
+	// or 0 if there is none
+	void settle(uint32_t pulse_us)
+	{
+		uint64_t share = (uint64_t)held_break_us * 100;
+		if (held && pulse_us && (share < (uint64_t)pulse_us * BREAK_MIN_PERCENT ||
+		                         share > (uint64_t)pulse_us * BREAK_MAX_PERCENT))
+		{
+			odd++;
+		}
+		held = false;
+	}
+
+public:
+	uint32_t samples = 0; // periods learned since load()
+
+	// restore a saved calibration, falls back to defaults when it is nonsense
+	void load(uint32_t period_us, uint32_t break_us)
+	{
+		if (plausible(period_us) && break_us < period_us)
+		{
+			period = period_us;
+			brk    = break_us;
+		}
+		else
+		{
+			period = DEFAULT_PERIOD_US;
+			brk    = DEFAULT_BREAK_US;
+		}
+		samples = 0;
+		end_digit();
+	}
+
+	// debounced falling edge (break starts), returns the verdict on the
+	// pulse before it
+	Pulse on_break(uint64_t time_us)
+	{
+		Pulse verdict = PULSE_NONE;
+		if (in_digit && made)
+		{
+			if ((uint32_t)(time_us - last_make_us) < noise_below(make_us(), NOISE_MAKE_US))
+			{
+				made = false;
+				return PULSE_NONE;  // the make was chatter, this break goes on
+			}
+			verdict = judge();
+		}
+		if (!in_digit)
+		{
+			digit_period_us = 0;
+			held            = false;
+		}
+		prev_break_us = last_break_us;
+		last_break_us = time_us;
+		in_digit = true;
+		made     = false;
+		return verdict;
+	}
+
+	// debounced rising edge (break ends)
+	void on_make(uint64_t time_us)
+	{
+		if (in_digit)
+		{
+			// a click in the pause after a digit must not hold the digit back
+			if ((uint32_t)(time_us - last_break_us) >= noise_below(brk, NOISE_BREAK_US))
+			{
+				rest_us = time_us;
+			}
+			last_make_us = time_us;
+			made         = true;
+		}
+	}
+
+	// the digit was emitted (or abandoned), the next break starts a new one;
+	// returns the verdict on its last pulse
+	Pulse end_digit()
+	{
+		Pulse verdict = in_digit && made ? judge() : PULSE_NONE;
+		settle(digit_period_us);    // the last pulse has no period of its own
+		in_digit = false;
+		made     = false;
+		counted  = false;
+		return verdict;
+	}
+
+	// longest end-of-digit silence, however slow the dial
+	void set_timeout_max_us(uint32_t us)
+	{
+		timeout_max = us < TIMEOUT_MIN_US ? TIMEOUT_MIN_US : us;
+	}
+
+	bool dialling() const { return in_digit; }
+
+	// pulses counted with a break/make ratio off spec since the last call
+	uint8_t take_odd()
+	{
+		uint8_t n = odd;
+		odd = 0;
+		return n;
+	}
+
+	uint32_t period_us() const { return period; }
+	uint32_t break_us() const { return brk; }
+	uint32_t make_us() const { return period > brk ? period - brk : 0; }
+
+	// silence after the last pulse that ends a digit
+	uint32_t digit_timeout_us() const
+	{
+		uint32_t t = period * TIMEOUT_PERIODS_X2 / 2;
+		if (t < TIMEOUT_MIN_US) return TIMEOUT_MIN_US;
+		if (t > timeout_max) return timeout_max;
+		return t;
+	}
+
+	// When the digit in progress is over. A dial comes to rest closed, so
+	// during a break only a stuck line ends it, once even the slowest dial
+	// would have made.
+	uint64_t digit_end_us() const
+	{
+		if (!made)
+		{
+			return last_break_us + (timeout_max > MAX_PERIOD_US ? timeout_max : MAX_PERIOD_US);
+		}
+		return rest_us + digit_timeout_us();
+	}
+};
+
+#endif /* DIAL_TIMING_H */
@@ -0,0 +1,561 @@
+/**
+ * @file dialer.cpp
+ * @brief rotary dial and hook switch handling
+ *
+ * Everything here reaches the hardware through hal.h only, so the same
+ * code runs on the RP2040 and in the host simulator (host/).
+ *
+ * The decoders (edge_task and its timers) run on core 1 and only
+ * produce DialEvents and debounced key levels; dial_event_task() and
+ * hid_task() on core 0 turn those into HID reports, so the USB stack never
+ * touches decoder state and vice versa.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+#include "hal.h"
+#include "dialer.h"
+#include "hid_queue.h"
+#include "phone.h"
+#include "keyboard.h"
+#include "usb_descriptors.h"
+#include "spsc_ring.h"
+#include "dial_timing.h"
+#include "debounce.h"
+#include "config.h"
+#include "macro.h"
+#include "dial_codes.h"
+#include "timers.h"
+#include "stats.h"
+
+//--------------------------------------------------------------------+
+// MACRO CONSTANT TYPEDEF PROTYPES
+//--------------------------------------------------------------------+
+
+// ---------------  DIAL CALIBRATION ----------------
+// End-of-digit timing is learned from the dial (see dial_timing.h) and kept
+// in the config store so a unit starts out tuned to its own dial.
+// Only line 0's dial is saved; the other lines start from it and learn
+// their own as they are used.
+#define CALIBRATION_IDLE_MS  2000          // on-hook this long before writing
+
+static uint32_t saved_period_us = 0;
+// ---------------------------------------------------
+
+// ---------------  LINES ---------------------------
+// One dial and hook switch per handset. All of them share the debouncer
+// below, so a tick costs the same however many lines are fitted, and only
+// a line whose pin changed is looked at after it.
+struct Line
+{
+  uint8_t    pulse_pin;
+  uint8_t    hangup_pin;
+  uint32_t   pulse_bit;           // 0 for a line that isn't fitted
+  uint32_t   hangup_bit;
+  DialTiming timing;
+  uint32_t   pulse_count;         // breaks in current digit
+  uint64_t   last_pulse_us;       // time of last accepted edge
+};
+
+static Line     lines[DIAL_LINES];
+static uint32_t pulse_mask  = 0;  // the pins of every fitted line
+static uint32_t hangup_mask = 0;
+// ---------------------------------------------------
+
+// ---------------  EDGE CAPTURE --------------------
+struct Edge
+{
+  uint64_t time_us;   // when the ISR ran, or the PIO saw a dial edge
+  uint8_t  gpio;
+  bool     level;     // pin level right after the edge
+};
+
+// Filled by edge_capture(), drained by edge_task(). The GPIO and PIO
+// interrupts share a priority on core 1, so they never push at once.
+static SpscRing<Edge, 64> edge_ring;
+
+// Filled by the decoders on core 1, drained by dial_event_task() on core 0.
+// Not the SIO FIFO: that one belongs to the flash write lockout.
+static SpscRing<DialEvent, 16> dial_events;
+
+// ---------------  DEBOUNCING ----------------------
+// One debouncer for the dial, the hook and the keys, ticked every
+// millisecond while a pin is settling. Edges still come by interrupt: they
+// restart a pin's count, wake the loop and give the exact change times.
+// Pins and hold times come from the config store at start-up.
+#define DEBOUNCE_TICK_US 1000
+
+static Debouncer inputs;
+static uint32_t  instant      = 0;            // pin levels after the latest edges
+static uint64_t  edge_us[32];                 // time of the latest edge per pin
+
+// Debounced key levels, read by hid_task() on core 0
+static std::atomic<uint32_t> key_levels{~0u};
+// ---------------------------------------------------
+
+static void calibration_load(void);
+static void calibration_save(void);
+static void post_event(uint8_t line, uint8_t kind, uint8_t digit, uint64_t time_us);
+
+KeyBoard keyboard;
+
+void dialer_init(void)
+{
+  // ---------- pulse and hang-up pins ---------
+  for (Line &l : lines)
+  {
+    uint8_t line = (uint8_t)(&l - lines);
+    if (config_line_pins(line, &l.pulse_pin, &l.hangup_pin))
+    {
+      l.pulse_bit  = 1u << l.pulse_pin;      // idle = high, pulse = low
+      l.hangup_bit = 1u << l.hangup_pin;     // idle = HIGH, active = LOW
+    }
+    pulse_mask  |= l.pulse_bit;
+    hangup_mask |= l.hangup_bit;
+  }
+  // ---------- every input, once, here --------
+  uint32_t pins = pulse_mask | hangup_mask | KeyBoard::key_mask;
+  hal_gpio_inputs_pullup(pins);              // keys: pressed = LOW
+  // ---------- debouncing --------------------
+  inputs.watch(pulse_mask, config.pulse_debounce_ms * 1000 / DEBOUNCE_TICK_US);
+  inputs.watch(hangup_mask, config.hangup_debounce_ms * 1000 / DEBOUNCE_TICK_US);
+  inputs.watch(KeyBoard::key_mask, config.key_debounce_ms * 1000 / DEBOUNCE_TICK_US);
+  uint64_t now_us = hal_time_us();
+  instant = hal_gpio_get_all();
+  inputs.reset(instant);
+  key_levels.store(inputs.state);
+  for (uint64_t &t : edge_us) t = now_us;
+  // ---------- edge interrupts ----------------
+  hal_gpio_enable_edge_irqs(hangup_mask | KeyBoard::key_mask);
+  hal_gpio_enable_edge_timers(pulse_mask);
+  // core 0 only hears about changes, tell it if a handset starts lifted
+  for (const Line &l : lines)
+  {
+    if (l.hangup_bit && !(inputs.state & l.hangup_bit))
+    {
+      post_event((uint8_t)(&l - lines), DIAL_EVENT_OFF_HOOK, DIAL_DIGIT_INVALID, now_us);
+    }
+  }
+  // -------------------------------------------
+  calibration_load();
+}
+
+static void HAL_RAM_FUNC(post_event)(uint8_t line, uint8_t kind, uint8_t digit, uint64_t time_us)
+{
+  DialEvent e = { time_us, kind, digit, line };
+  if (dial_events.push(e))
+  {
+    hal_wake_other_core();
+  }
+  else
+  {
+    stats_count(COUNTER_EVENT_DROPS);
+  }
+}
+
+void HAL_RAM_FUNC(edge_capture)(uint8_t gpio, bool level, uint64_t time_us)
+{
+  Edge e = { time_us, gpio, level };
+  edge_ring.push(e);
+}
+
+static void calibration_load(void)
+{
+  // zeros until first saved, load() takes the defaults then
+  for (Line &l : lines)
+  {
+    l.timing.load(config.dial_period_us, config.dial_break_us);
+    l.timing.set_timeout_max_us(config.digit_timeout_ms * 1000);
+  }
+  saved_period_us = config.dial_period_us ? lines[0].timing.period_us() : 0;
+}
+
+// persist a calibration that moved by more than 1/16, once the
+// handset has been resting for a while
+static uint64_t calibration_due_us(void)
+{
+  const Line &l = lines[0];
+  uint32_t period = l.timing.period_us();
+  uint32_t drift  = period > saved_period_us ? period - saved_period_us
+                                             : saved_period_us - period;
+  if (!(instant & l.hangup_bit) || l.timing.samples < 16 || drift <= saved_period_us / 16)
+  {
+    return UINT64_MAX;
+  }
+  return edge_us[l.hangup_pin] + CALIBRATION_IDLE_MS * 1000;
+}
+
+static void calibration_save(void)
+{
+  const Line &l = lines[0];
+  config_set(CONFIG_DIAL_PERIOD_US, l.timing.period_us());
+  config_set(CONFIG_DIAL_BREAK_US, l.timing.break_us());
+  saved_period_us = l.timing.period_us();
+}
+
+static void calibration_fire(uint64_t due_us)
+{
+  (void)due_us;
+  calibration_save();
+}
+
+// follow the hook: armed while resting on-hook with a drifted calibration
+static void calibration_arm(void)
+{
+  uint64_t due_us = calibration_due_us();
+  if (due_us == UINT64_MAX) timer_cancel(TIMER_CALIBRATION);
+  else                      timer_at(TIMER_CALIBRATION, due_us, calibration_fire);
+}
+
+//--------------------------------------------------------------------+
+// USB HID
+//--------------------------------------------------------------------+
+
+// Core 1 debounces the key pins and wakes us when one changes; we send a
+// report when the debounced keys differ from the last one
+void hid_task(void)
+{
+    if (!keyboard.update(key_levels.load(std::memory_order_acquire)))
+    {
+        return; // same keys as last time, the host already knows
+    }
+
+    // Remote wakeup
+    if (hal_usb_suspended())
+    {
+        // Wake up host if we are in suspend mode
+        // and REMOTE_WAKEUP feature is enabled by host
+        if (keyboard.any_pressed())
+        {
+            hal_usb_remote_wakeup();
+        }
+        return;
+    }
+
+    // every report carries the whole state, so one lost to a full queue is
+    // made good by the next change
+    hid_queue_report(0, keyboard.modifier, keyboard.key_codes);
+}
+
+//--------------------------------------------------------------------+
+// Dial and hook
+//--------------------------------------------------------------------+
+
+static inline uint8_t ascii_to_key(char c)            // lower/upper A-Z only
+{
+  if (c >= 'a' && c <= 'z') return HID_KEY_A + (c - 'a');
+  if (c >= 'A' && c <= 'Z') return HID_KEY_A + (c - 'A');
+  return 0;
+}
+
+static void HAL_RAM_FUNC(count_pulse)(Line &l, DialTiming::Pulse pulse)
+{
+  if (pulse == DialTiming::PULSE_OK)
+  {
+    ++l.pulse_count;
+  }
+  if (pulse == DialTiming::PULSE_NOISE) stats_count(COUNTER_NOISE_PULSES);
+  if (uint8_t odd = l.timing.take_odd()) stats_count(COUNTER_ODD_PULSES, odd);
+}
+
+static void digit_end(uint64_t due_us);
+
+// one timer for every line, armed for the one whose silence ends first
+static void HAL_RAM_FUNC(digit_end_arm)(void)
+{
+  uint64_t due_us = UINT64_MAX;
+  for (const Line &l : lines)
+  {
+    if (l.timing.dialling() && l.timing.digit_end_us() < due_us)
+    {
+      due_us = l.timing.digit_end_us();
+    }
+  }
+
+  if (due_us == UINT64_MAX) timer_cancel(TIMER_DIGIT_END);
+  else                      timer_at(TIMER_DIGIT_END, due_us, digit_end);
+}
+
+/* --------- end-of-digit (learned silence) -------------------- */
+static void HAL_RAM_FUNC(finish_digit)(Line &l)
+{
+  count_pulse(l, l.timing.end_digit());
+  uint32_t cnt  = l.pulse_count;
+  l.pulse_count = 0;
+  if (cnt == 0)
+  {
+    return;         // a break that never ended, or only noise
+  }
+
+  uint8_t digit = (cnt == 10) ? 0 : (cnt <= 9 ? cnt : DIAL_DIGIT_INVALID);
+  if (digit == DIAL_DIGIT_INVALID)
+  {
+    stats_count(COUNTER_BAD_DIGITS);
+  }
+  post_event((uint8_t)(&l - lines), DIAL_EVENT_DIGIT, digit, l.last_pulse_us);
+}
+
+static void HAL_RAM_FUNC(digit_end)(uint64_t due_us)
+{
+  for (Line &l : lines)
+  {
+    if (l.timing.dialling() && l.timing.digit_end_us() <= due_us)
+    {
+      finish_digit(l);
+    }
+  }
+  digit_end_arm();
+}
+
+// a debounced change dates from the edge that started the stable level
+static void HAL_RAM_FUNC(pulse_change)(Line &l)
+{
+  l.last_pulse_us = edge_us[l.pulse_pin];
+  if (!(inputs.state & l.pulse_bit))
+  {
+    // a pulse is judged, and counted, once the next one starts
+    count_pulse(l, l.timing.on_break(l.last_pulse_us));
+  }
+  else
+  {
+    l.timing.on_make(l.last_pulse_us);
+  }
+  digit_end_arm();
+}
+
+static void HAL_RAM_FUNC(debounce_tick)(uint64_t due_us)
+{
+  inputs.tick(hal_gpio_get_all());
+  uint32_t changed = inputs.rose | inputs.fell;
+
+  // nothing is dialled while on-hook
+  if (changed & pulse_mask)
+  {
+    for (Line &l : lines)
+    {
+      if ((changed & l.pulse_bit) && !(instant & l.hangup_bit))
+      {
+        pulse_change(l);
+      }
+    }
+  }
+
+  // ----------- hook ( ≥50 ms stable ) ---------------------------------
+  if (changed & hangup_mask)
+  {
+    for (const Line &l : lines)
+    {
+      if (changed & l.hangup_bit)
+      {
+        post_event((uint8_t)(&l - lines),
+                   (inputs.state & l.hangup_bit) ? DIAL_EVENT_ON_HOOK : DIAL_EVENT_OFF_HOOK,
+                   0, edge_us[l.hangup_pin]);
+      }
+    }
+  }
+
+  if (changed & KeyBoard::key_mask)
+  {
+    key_levels.store(inputs.state, std::memory_order_release);
+    hal_wake_other_core();
+  }
+
+  // a late tick is caught up on the next pass, not skipped
+  if (inputs.settling())
+  {
+    timer_at(TIMER_DEBOUNCE, due_us + DEBOUNCE_TICK_US, debounce_tick);
+  }
+}
+
+void HAL_RAM_FUNC(edge_task)(void)
+{
+  static uint32_t seen_drops = 0;
+
+  uint32_t edges = 0;
+  Edge     e;
+  while (edge_ring.pop(e))
+  {
+    uint32_t bit = 1u << e.gpio;
+
+    // an edge while the pin is away from its debounced level cut a window short
+    if ((instant ^ inputs.state) & bit)
+    {
+      if      (bit & pulse_mask)  stats_count(COUNTER_PULSE_BOUNCES);
+      else if (bit & hangup_mask) stats_count(COUNTER_HOOK_BOUNCES);
+    }
+    instant = e.level ? instant | bit : instant & ~bit;
+    edge_us[e.gpio] = e.time_us;
+    edges |= bit;
+  }
+
+  uint64_t now_us = hal_time_us();
+
+  // ring overflowed during a bounce storm: resync from the pins
+  if (edge_ring.dropped() != seen_drops)
+  {
+    stats_count(COUNTER_EDGE_DROPS, edge_ring.dropped() - seen_drops);
+    seen_drops = edge_ring.dropped();
+    instant = hal_gpio_get_all();
+    for (uint64_t &t : edge_us) t = now_us;
+    edges = ~0u;
+  }
+
+  if (!edges)
+  {
+    return;
+  }
+  inputs.restart(edges);
+
+  // Abort dialling when a handset is hung up (hook pin is HIGH)
+  if (edges & hangup_mask & instant)
+  {
+    for (Line &l : lines)
+    {
+      if (edges & l.hangup_bit & instant)
+      {
+        l.pulse_count = 0;
+        l.timing.end_digit();
+        // a new digit timeout from the config store applies from the next call
+        l.timing.set_timeout_max_us(config.digit_timeout_ms * 1000);
+      }
+    }
+    digit_end_arm();
+  }
+  if (edges & lines[0].hangup_bit)
+  {
+    calibration_arm();
+  }
+
+  // the first tick right away only starts the count, so a clean edge is
+  // decided exactly its hold time later
+  if (!timer_armed(TIMER_DEBOUNCE))
+  {
+    timer_at(TIMER_DEBOUNCE, now_us, debounce_tick);
+  }
+}
+
+//--------------------------------------------------------------------+
+// Decoded events to reports (core 0)
+//--------------------------------------------------------------------+
+
+// The digits of each line's call so far, for the boot code
+struct Call
+{
+  uint32_t history       = 0xFFFFFFFFu;   // one digit per nibble, newest lowest
+  uint8_t  digits        = 0;             // since the hook change, CALL_CLOSED after a pause
+  uint64_t last_digit_us = 0;
+};
+
+#define CALL_CLOSED 0xFF
+
+static Call calls[DIAL_LINES];
+
+static void on_digit(uint8_t line, uint8_t digit, uint64_t time_us)
+{
+  /* ---------- boot code detector ("1234") --------------------- */
+  Call &call = calls[line];
+
+  // like the dial codes, the boot code must be the first digits of a call
+  // and can't span a pause
+  if (call.digits && time_us - call.last_digit_us > DIAL_CODE_GAP_MS * 1000ull)
+  {
+    call.digits = CALL_CLOSED;
+  }
+  call.last_digit_us = time_us;
+  call.history = (call.history << 4) | (digit <= 9 ? digit : 0xE);
+  if (call.digits < CALL_CLOSED - 1)
+  {
+    call.digits++;
+  }
+
+  // compare the digits of the code only, not the 0xF padding above them
+  uint32_t code   = config.boot_code;
+  uint32_t mask   = 0;
+  uint8_t  length = 0;
+  for (uint32_t shift = 0; shift < 32 && ((code >> shift) & 0xF) != 0xF; shift += 4)
+  {
+    mask |= 0xFu << shift;
+    length++;
+  }
+  if (mask && call.digits == length && (call.history & mask) == (code & mask))
+  {
+    hal_reboot_to_bootloader();
+  }
+  /* ------------------------------------------------------------- */
+
+  uint8_t digit_key;
+  if      (digit == 0) digit_key = HID_KEY_0;
+  else if (digit <= 9) digit_key = HID_KEY_1 + (digit - 1);
+  else                 digit_key = 0;
+
+  // press + release go out back-to-back from the HID queue
+  if (digit_key)
+  {
+    hid_queue_stamp(LATENCY_DIGIT, time_us);
+    hid_queue_key(line, 0, digit_key);
+  }
+
+  // and the far end hears it, for bridges and menus that want tones
+  if (line == 0 && digit <= 9)
+  {
+    hal_handset_digit(digit);
+  }
+
+  // a code's action goes out after the digit that completed it
+  DialCodeAction action;
+  if (dial_codes_feed(line, digit, time_us, &action))
+  {
+    if (action == DIAL_CODE_MUTE)
+    {
+      phone_mute_press(line);
+    }
+    else
+    {
+      macro_set_gap_ms((uint8_t)config.macro_gap_ms);
+      macro_run(line, action == DIAL_CODE_ANSWER ? MACRO_ANSWER : MACRO_HANG_UP);
+    }
+  }
+}
+
+static void on_hook(uint8_t line, bool on_hook, uint64_t time_us)
+{
+  // the audio function is line 0's handset
+  if (line == 0)
+  {
+    hal_handset_off_hook(!on_hook);
+  }
+
+  // every call starts a fresh code
+  calls[line].history = 0xFFFFFFFFu;
+  calls[line].digits  = 0;
+  dial_codes_reset(line);
+
+  // lifting the handset wakes a suspended host
+  if (!on_hook && hal_usb_suspended())
+  {
+    hal_usb_remote_wakeup();
+  }
+
+  // one telephony report per change: lifting answers, hanging up ends
+  hid_queue_stamp(LATENCY_HOOK, time_us);
+  phone_hook(line, !on_hook);
+
+  // for call apps that ignore the telephony page
+  if (on_hook && config.hang_up_macro)
+  {
+    macro_set_gap_ms((uint8_t)config.macro_gap_ms);
+    macro_run(line, MACRO_HANG_UP);
+  }
+}
+
+void dial_event_task(void)
+{
+  DialEvent e;
+  while (dial_events.pop(e))
+  {
+    if (e.kind == DIAL_EVENT_DIGIT) on_digit(e.line, e.digit, e.time_us);
+    else                            on_hook(e.line, e.kind == DIAL_EVENT_ON_HOOK, e.time_us);
+  }
+}
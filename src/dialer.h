@@ -0,0 +1,57 @@
+/**
+ * @file dialer.h
+ * @brief rotary dial and hook switch handling, built only on hal.h
+ */
+
+#ifndef DIALER_H
+#define DIALER_H
+
+#include <stdint.h>
+
+#include "usb_descriptors.h"    // DIAL_LINES
+
+// ---------------  PULSE-COUNT INPUT ----------------
+#define PULSE_PIN           27      // free GPIO used for pulse train
+#define PULSE_DEBOUNCE_MS    5      // match back-ported debounce
+// ---------------------------------------------------
+
+// ---------------  HANG-UP INPUT -----------------
+#define HANGUP_PIN          13      // unused GPIO, pulled-up HIGH
+#define HANGUP_DEBOUNCE_MS  50
+// ------------------------------------------------
+
+// What the decoders tell the USB side
+enum DialEventKind
+{
+  DIAL_EVENT_DIGIT,       // a digit has been dialled
+  DIAL_EVENT_OFF_HOOK,    // handset lifted
+  DIAL_EVENT_ON_HOOK      // handset replaced
+};
+
+#define DIAL_DIGIT_INVALID  0xFF  // more than ten pulses
+
+struct DialEvent
+{
+  uint64_t time_us;       // last pulse edge or hook edge, not the decision
+  uint8_t  kind;          // DialEventKind
+  uint8_t  digit;         // 0-9 or DIAL_DIGIT_INVALID for DIAL_EVENT_DIGIT
+  uint8_t  line;          // which handset, below DIAL_LINES
+};
+
+// ---------------  DECODERS (core 1) ---------------
+// Configure the pins of every fitted line (config_line_pins()) and restore
+// the dial calibration. Edge interrupts are taken on the core that calls this.
+void dialer_init(void);
+
+// Queue one pin edge; safe to call from an interrupt handler
+void edge_capture(uint8_t gpio, bool level, uint64_t time_us);
+
+// Feed captured edges to the debouncer. The debounce ticks, end of digit
+// and calibration save then run from core 1's timers (timers.h).
+void edge_task(void);
+
+// ---------------  REPORTS (core 0) ----------------
+void dial_event_task(void);  // turns DialEvents into keystrokes and phone reports
+void hid_task(void);         // keyboard implementation, on debounced key changes
+
+#endif /* DIALER_H */
@@ -0,0 +1,221 @@
+/**
+ * @file dsp.cpp
+ * @brief fixed-point voice chain, see dsp.h
+ *
+ * Core 0's interpolators belong to this file. Interpolator 0 runs in blend
+ * mode (base0 + (base1 - base0) * alpha / 256) and does the multiplies by
+ * small fractions; interpolator 1 shifts a Q8 value down and clamps it to
+ * 16 bits, which is the last step of every stage that can grow a sample.
+ */
+
+#include <stdlib.h>
+
+#include "dsp.h"
+#include "dtmf.h"
+#include "hardware/interp.h"
+#include "hardware/structs/systick.h"
+
+static_assert(DSP_STAGE_COUNT == STATS_DSP_STAGES, "StatsDsp out of date");
+
+#define SYSTICK_MASK    0x00FFFFFFu     // 24-bit down-counter at clk_sys
+
+#define HP_ALPHA        1               // /256 per sample: ~30 Hz at 48 kHz
+
+#define GATE_OPEN_LEVEL   320           // mean |x| of a block, about -40 dBFS
+#define GATE_CLOSE_LEVEL  200
+#define GATE_HOLD_BLOCKS  150           // stay open through pauses between words
+#define GATE_ATTACK_STEP  64            // alpha per block: open in 4 ms
+#define GATE_RELEASE_STEP 8             // close in 32 ms
+#define GATE_OPEN         256           // alpha of an open gate, skips the blend
+
+#define AGC_TARGET_LEVEL  4096          // mean |x| of speech, about -18 dBFS
+#define AGC_GAIN_MIN      256           // Q8, 0 dB
+#define AGC_GAIN_MAX      (16 * 256)    // +24 dB
+
+static uint8_t  stages      = DSP_ALL_STAGES;
+static int32_t  hp_low      = 0;        // the part the high-pass removes, Q8
+static uint32_t gate_alpha  = GATE_OPEN;
+static uint32_t gate_hold   = 0;
+static int32_t  agc_gain    = AGC_GAIN_MIN;
+static StatsDsp cycles;
+
+static uint32_t mean_level(const int16_t *pcm, size_t samples)
+{
+    uint32_t sum = 0;
+    for (size_t i = 0; i < samples; i++)
+    {
+        sum += abs(pcm[i]);
+    }
+    return sum / samples;
+}
+
+// Interpolator 1 lane 0: (accum0 >> 8), sign-extended, clamped to int16
+static inline int16_t clamp_q8(int32_t v)
+{
+    interp1->accum[0] = (uint32_t)v;
+    return (int16_t)interp1->peek[0];
+}
+
+static void highpass(int16_t *pcm, size_t samples)
+{
+    interp0->accum[1] = HP_ALPHA;
+    for (size_t i = 0; i < samples; i++)
+    {
+        int32_t x = (int32_t)pcm[i] << 8;
+
+        // hp_low += (x - hp_low) * HP_ALPHA / 256
+        interp0->base[0] = (uint32_t)hp_low;
+        interp0->base[1] = (uint32_t)x;
+        hp_low = (int32_t)interp0->peek[1];
+
+        pcm[i] = clamp_q8(x - hp_low);
+    }
+}
+
+static void gate(int16_t *pcm, size_t samples)
+{
+    uint32_t level = mean_level(pcm, samples);
+
+    if (level >= GATE_OPEN_LEVEL)
+    {
+        gate_hold = GATE_HOLD_BLOCKS;
+    }
+    else if (level < GATE_CLOSE_LEVEL && gate_hold)
+    {
+        gate_hold--;
+    }
+
+    if (gate_hold)
+    {
+        gate_alpha = gate_alpha + GATE_ATTACK_STEP > GATE_OPEN ? GATE_OPEN : gate_alpha + GATE_ATTACK_STEP;
+    }
+    else
+    {
+        gate_alpha = gate_alpha < GATE_RELEASE_STEP ? 0 : gate_alpha - GATE_RELEASE_STEP;
+    }
+
+    if (gate_alpha == GATE_OPEN)
+    {
+        return;
+    }
+
+    // x * alpha / 256 is a blend from 0 to x
+    interp0->accum[1] = gate_alpha;
+    interp0->base[0]  = 0;
+    for (size_t i = 0; i < samples; i++)
+    {
+        interp0->base[1] = (uint32_t)(int32_t)pcm[i];
+        pcm[i] = (int16_t)interp0->peek[1];
+    }
+}
+
+static void agc(int16_t *pcm, size_t samples)
+{
+    // adapt on speech only, or the noise floor gets pulled up to the target
+    if (gate_alpha == GATE_OPEN)
+    {
+        uint32_t out_level = (mean_level(pcm, samples) * (uint32_t)agc_gain) >> 8;
+
+        if (out_level > AGC_TARGET_LEVEL)
+        {
+            agc_gain -= agc_gain >> 3;          // ~1 dB per block down
+        }
+        else
+        {
+            agc_gain += (agc_gain >> 10) + 1;   // ~8 dB per second up
+        }
+        if (agc_gain < AGC_GAIN_MIN) agc_gain = AGC_GAIN_MIN;
+        if (agc_gain > AGC_GAIN_MAX) agc_gain = AGC_GAIN_MAX;
+    }
+
+    for (size_t i = 0; i < samples; i++)
+    {
+        pcm[i] = clamp_q8(pcm[i] * agc_gain);
+    }
+}
+
+static void (*const stage_fn[DSP_STAGE_COUNT])(int16_t *, size_t) = { highpass, gate, agc, dtmf_mix };
+
+void dsp_init(void)
+{
+    // blend mode needs lane 1 signed for signed samples
+    interp_config c = interp_default_config();
+    interp_config_set_blend(&c, true);
+    interp_set_config(interp0, 0, &c);
+    c = interp_default_config();
+    interp_config_set_signed(&c, true);
+    interp_set_config(interp0, 1, &c);
+
+    c = interp_default_config();
+    interp_config_set_clamp(&c, true);
+    interp_config_set_shift(&c, 8);
+    interp_config_set_mask(&c, 0, 23);
+    interp_config_set_signed(&c, true);
+    interp_set_config(interp1, 0, &c);
+    interp1->base[0] = (uint32_t)INT16_MIN;
+    interp1->base[1] = (uint32_t)INT16_MAX;
+
+    systick_hw->rvr = SYSTICK_MASK;
+    systick_hw->cvr = 0;
+    systick_hw->csr = 0x5;      // enabled, clk_sys, no interrupt
+
+    dsp_reset_cycles();
+}
+
+void dsp_process(int16_t *pcm, size_t samples)
+{
+    uint32_t chain_start = systick_hw->cvr;
+
+    for (int s = 0; s < DSP_STAGE_COUNT; s++)
+    {
+        if (!(stages & (1u << s)))
+        {
+            continue;
+        }
+
+        uint32_t start = systick_hw->cvr;
+        stage_fn[s](pcm, samples);
+        uint32_t spent = (start - systick_hw->cvr) & SYSTICK_MASK;
+
+        cycles.cycles[s] += spent;
+        if (spent > cycles.max_cycles[s])
+        {
+            cycles.max_cycles[s] = spent > UINT16_MAX ? UINT16_MAX : (uint16_t)spent;
+        }
+    }
+
+    uint32_t chain = (chain_start - systick_hw->cvr) & SYSTICK_MASK;
+    if (chain > cycles.max_chain_cycles)
+    {
+        cycles.max_chain_cycles = chain;
+    }
+    cycles.blocks++;
+}
+
+void dsp_set_stages(uint8_t mask)
+{
+    uint8_t on = mask & ~stages;
+
+    // start switched-on stages from rest rather than from stale state
+    if (on & (1u << DSP_HIGHPASS))
+    {
+        hp_low = 0;
+    }
+    if (!(mask & (1u << DSP_GATE)))
+    {
+        gate_alpha = GATE_OPEN;     // the AGC reads it
+        gate_hold  = 0;
+    }
+    stages = mask & DSP_ALL_STAGES;
+}
+
+void dsp_read_cycles(StatsDsp *out)
+{
+    *out        = cycles;
+    out->stages = stages;
+}
+
+void dsp_reset_cycles(void)
+{
+    cycles = StatsDsp{};
+}
@@ -0,0 +1,44 @@
+/**
+ * @file dsp.h
+ * @brief fixed-point voice chain for the mic stream: high-pass, gate, AGC, DTMF
+ *
+ * Runs on core 0 on each 1 ms packet (47-49 samples) before it goes to
+ * USB. Everything is integer: the high-pass and the gate ramp use the
+ * blend mode of SIO interpolator 0, and interpolator 1 clamps to 16 bits
+ * in hardware. Each stage can be switched off at runtime and has its own
+ * cycle count, measured with SysTick.
+ */
+
+#ifndef DSP_H
+#define DSP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "stats.h"
+
+enum DspStage
+{
+    DSP_HIGHPASS,       // one-pole, ~30 Hz: DC bias and handling rumble
+    DSP_GATE,           // mutes what stays under the noise floor
+    DSP_AGC,            // slow gain towards a fixed speech level, +24 dB max
+    DSP_DTMF,           // tone pair of a dialled digit over the ducked voice, dtmf.h
+    DSP_STAGE_COUNT
+};
+
+#define DSP_ALL_STAGES ((1u << DSP_STAGE_COUNT) - 1)
+
+// Once at start-up, on core 0
+void dsp_init(void);
+
+// Process one block in place
+void dsp_process(int16_t *pcm, size_t samples);
+
+// Bit i enables DspStage i; a stage that is off passes samples through
+void dsp_set_stages(uint8_t mask);
+
+// Cycle counts since the last dsp_reset_cycles()
+void dsp_read_cycles(StatsDsp *out);
+void dsp_reset_cycles(void);
+
+#endif /* DSP_H */
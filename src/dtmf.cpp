@@ -0,0 +1,126 @@
+/**
+ * @file dtmf.cpp
+ * @brief phase-accumulator DTMF synthesis, see dtmf.h
+ */
+
+#include "dtmf.h"
+#include "tusb.h"       // AUDIO_SAMPLE_RATE
+#include "pico/time.h"
+
+#define TABLE_BITS      8
+#define TABLE_SIZE      (1u << TABLE_BITS)
+#define TONE_SAMPLES    (DTMF_TONE_MS * AUDIO_SAMPLE_RATE / 1000)
+#define RAMP_SAMPLES    (1u << DTMF_RAMP_BITS)
+
+// Q15 amplitudes: the low group at about -10.5 dBFS and the high group 2 dB
+// above it, the usual twist. With the ducked voice the sum can't clip.
+#define LOW_AMPLITUDE   9830
+#define HIGH_AMPLITUDE  12380
+#define DUCK_SHIFT      3       // voice under a tone, -18 dB
+
+static_assert(TONE_SAMPLES >= 2 * RAMP_SAMPLES, "tone shorter than its fades");
+
+static constexpr double PI = 3.14159265358979323846;
+
+// sin(x) for |x| <= pi from its Taylor series, far past 16 bits
+static constexpr double taylor_sin(double x)
+{
+    double term = x, sum = x;
+    for (int n = 1; n < 12; n++)
+    {
+        term *= -x * x / ((2 * n) * (2 * n + 1));
+        sum  += term;
+    }
+    return sum;
+}
+
+struct SineTable
+{
+    int16_t at[TABLE_SIZE];     // one period, Q15
+};
+
+static constexpr SineTable make_sine(void)
+{
+    SineTable t = {};
+    for (uint32_t i = 0; i < TABLE_SIZE; i++)
+    {
+        double x = 2 * PI * i / TABLE_SIZE;
+        double v = taylor_sin(x > PI ? x - 2 * PI : x) * 32767;
+        t.at[i] = (int16_t)(v < 0 ? v - 0.5 : v + 0.5);
+    }
+    return t;
+}
+
+static constexpr SineTable sine = make_sine();
+
+// phase step per sample of a frequency, a full turn is 2^32
+static constexpr uint32_t step(double hz)
+{
+    return (uint32_t)(hz * 4294967296.0 / AUDIO_SAMPLE_RATE + 0.5);
+}
+
+struct TonePair
+{
+    uint32_t low;
+    uint32_t high;
+};
+
+static constexpr TonePair pairs[10] = {
+    { step(941), step(1336) },  // 0
+    { step(697), step(1209) },  // 1
+    { step(697), step(1336) },  // 2
+    { step(697), step(1477) },  // 3
+    { step(770), step(1209) },  // 4
+    { step(770), step(1336) },  // 5
+    { step(770), step(1477) },  // 6
+    { step(852), step(1209) },  // 7
+    { step(852), step(1336) },  // 8
+    { step(852), step(1477) },  // 9
+};
+
+static TonePair tone;
+static TonePair phase;
+static uint32_t played     = 0;
+static uint32_t left       = 0;             // samples to go, 0 when silent
+static uint64_t started_us = 0;
+
+void dtmf_start(uint8_t digit)
+{
+    if (digit > 9)
+    {
+        return;
+    }
+    tone       = pairs[digit];
+    phase      = {};
+    played     = 0;
+    left       = TONE_SAMPLES;
+    started_us = time_us_64();
+}
+
+void dtmf_mix(int16_t *pcm, size_t samples)
+{
+    if (!left)
+    {
+        return;
+    }
+    if (time_us_64() - started_us > 2 * DTMF_TONE_MS * 1000)
+    {
+        left = 0;
+        return;
+    }
+
+    for (size_t i = 0; i < samples && left; i++, played++, left--)
+    {
+        int32_t v = (sine.at[phase.low >> (32 - TABLE_BITS)] * LOW_AMPLITUDE +
+                     sine.at[phase.high >> (32 - TABLE_BITS)] * HIGH_AMPLITUDE) >> 15;
+        phase.low  += tone.low;
+        phase.high += tone.high;
+
+        uint32_t edge = played < left ? played : left;
+        if (edge < RAMP_SAMPLES)
+        {
+            v = (v * (int32_t)edge) >> DTMF_RAMP_BITS;
+        }
+        pcm[i] = (int16_t)((pcm[i] >> DUCK_SHIFT) + v);
+    }
+}
@@ -0,0 +1,30 @@
+/**
+ * @file dtmf.h
+ * @brief DTMF tone pairs for dialled digits, mixed into the mic stream
+ *
+ * Many meeting apps ignore typed digits, but a conference bridge or IVR on
+ * the far end hears tones. Each digit dialled on line 0 starts its tone
+ * pair, which the last stage of the voice chain (dsp.h) adds to the
+ * outgoing blocks for DTMF_TONE_MS while the voice under it is ducked.
+ * Two 32-bit phase accumulators step through one sine table, so a 1 ms
+ * block costs two table reads and a few adds per sample.
+ */
+
+#ifndef DTMF_H
+#define DTMF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DTMF_TONE_MS    100     // receivers want 40 ms or more
+#define DTMF_RAMP_BITS  6       // 64-sample fade in and out, no clicks
+
+// Core 0: start the tone pair of digit (0-9), cutting short one playing
+void dtmf_start(uint8_t digit);
+
+// The DSP_DTMF stage: add the tone, if one is playing, to a block of mic
+// PCM in place. A tone the stream doesn't get to play within twice its
+// length, because the host had it closed, is dropped.
+void dtmf_mix(int16_t *pcm, size_t samples);
+
+#endif /* DTMF_H */
@@ -0,0 +1,87 @@
+/**
+ * @file hal.h
+ * @brief the few hardware services the dialer logic needs
+ *
+ * dialer.cpp and keyboard.h only talk to the hardware through these calls.
+ * hal_pico.cpp implements them on the RP2040, host/hal_sim.cpp implements
+ * them with a simulated clock, simulated pins and a recording HID sink.
+ */
+
+#ifndef HAL_H
+#define HAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "class/hid/hid.h" // HID_KEY_*, KEYBOARD_MODIFIER_*
+
+// Keeps an interrupt handler or decoder step in SRAM on the RP2040, so it
+// never waits on a flash cache miss. Plain functions on the host.
+#if PICO_ON_DEVICE
+#include "pico/platform.h"
+#define HAL_RAM_FUNC(name) __not_in_flash_func(name)
+#else
+#define HAL_RAM_FUNC(name) name
+#endif
+
+// ---------------  TIME ----------------------------
+uint64_t hal_time_us(void);
+
+// ---------------  GPIO ----------------------------
+// pins and the results are masks, bit n = GPIO n
+void hal_gpio_inputs_pullup(uint32_t pins);
+uint32_t hal_gpio_get_all(void);
+
+// Every edge on pins is reported through edge_capture() (dialer.h), on
+// the core that calls this
+void hal_gpio_enable_edge_irqs(uint32_t pins);
+// The same for up to HAL_EDGE_TIMERS pins whose edges need exact times, the
+// dials: on the RP2040 a PIO state machine stamps each edge, so the time
+// holds however late the interrupt that queues it runs
+#define HAL_EDGE_TIMERS 4
+void hal_gpio_enable_edge_timers(uint32_t pins);
+
+// ---------------  USB -----------------------------
+bool hal_hid_ready(void);
+bool hal_hid_keyboard_report(uint8_t report_id, uint8_t modifier, const uint8_t keycode[6]);
+bool hal_hid_phone_report(uint8_t report_id, uint8_t buttons);
+bool hal_usb_suspended(void);
+void hal_usb_remote_wakeup(void);
+// macro_run() accepted a macro for line; nothing on the RP2040, the host
+// fuzzer checks the rate limit against it
+void hal_macro_started(uint8_t line);
+
+// ---------------  AUDIO ---------------------------
+// Hook state as core 0 sees it; the sidetone only plays while lifted
+void hal_handset_off_hook(bool off_hook);
+// A digit dialled on the handset, played to the far end as its DTMF tone
+void hal_handset_digit(uint8_t digit);
+
+// ---------------  SYSTEM --------------------------
+void hal_reboot_to_bootloader(void);
+
+// Wake the other core if it is waiting for an event (see power.h)
+void hal_wake_other_core(void);
+
+// RP2040 only: raise the edge interrupt of pin by software count times on
+// this core and time each one from the raise to the start of the callback,
+// in clk_sys cycles. Pin must have edge interrupts enabled.
+void hal_gpio_irq_latency(uint8_t pin, uint8_t count, uint16_t *min_cycles, uint16_t *max_cycles);
+
+// ---------------  FLASH ---------------------------
+// The config store (config.cpp): the last HAL_FLASH_SECTORS erase sectors,
+// read straight from memory. Erased bytes read 0xFF and programming a page
+// can only clear bits. The other core is held off while flash is written.
+#define HAL_FLASH_SECTOR_SIZE 4096
+#define HAL_FLASH_PAGE_SIZE   256
+#define HAL_FLASH_SECTORS     2
+
+const uint8_t *hal_flash_store(void);
+void hal_flash_erase(uint32_t sector);
+void hal_flash_program(uint32_t offset, const uint8_t page[HAL_FLASH_PAGE_SIZE]);
+
+// Keeps the two cores from updating the store at the same time
+void hal_flash_lock(void);
+void hal_flash_unlock(void);
+
+#endif /* HAL_H */
@@ -0,0 +1,275 @@
+/**
+ * @file hal_pico.cpp
+ * @brief hal.h on the RP2040 with the Pico SDK and TinyUSB
+ */
+
+#include "tusb.h"
+
+#include "hal.h"
+#include "dialer.h"
+#include "dtmf.h"
+#include "speaker.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+#include "hardware/structs/iobank0.h"
+#include "hardware/structs/systick.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "pico/multicore.h"
+#include "pico/mutex.h"
+#include "pico/time.h"
+#include "edge_timer.pio.h"
+extern "C" {
+#include "pico/bootrom.h"
+}
+
+// -----------------------------------------------------------------
+// Arduino-compat helpers for reset_usb_boot() call
+#ifndef LED_BUILTIN
+#include "pico/stdlib.h"
+#define LED_BUILTIN PICO_DEFAULT_LED_PIN   // map to Pico's on-board LED
+#endif
+
+static inline uint digitalPinToPinName(uint pin) { return pin; }
+// -----------------------------------------------------------------
+
+// The config store takes the last flash sectors
+#define STORE_OFFSET    (PICO_FLASH_SIZE_BYTES - HAL_FLASH_SECTORS * FLASH_SECTOR_SIZE)
+
+#define SYSTICK_MASK    0x00FFFFFFu     // 24-bit down-counter at clk_sys
+
+static_assert(HAL_FLASH_SECTOR_SIZE == FLASH_SECTOR_SIZE && HAL_FLASH_PAGE_SIZE == FLASH_PAGE_SIZE,
+              "hal.h flash geometry");
+
+#define STAMP_MASK      0x7FFFFFFFu     // edge timer stamps, 31 bits of 1 us
+
+static_assert(DIAL_LINES <= HAL_EDGE_TIMERS && HAL_EDGE_TIMERS <= NUM_PIO_STATE_MACHINES,
+              "a state machine per dial");
+
+auto_init_mutex(store_mutex);
+
+// The dial edge timers, one state machine each, all started together
+static PIO      const edge_pio = pio0;
+static uint8_t  edge_pins[HAL_EDGE_TIMERS];
+static uint32_t edge_sms     = 0;       // running state machines, bit n = SM n
+static uint64_t edge_base_us = 0;       // time_us_64() when they started
+
+// A software-raised edge interrupt while hal_gpio_irq_latency() runs
+static volatile uint32_t *probe_force = nullptr;   // INTF word, null when idle
+static uint32_t           probe_bit   = 0;
+static uint8_t            probe_pin   = 0;
+static volatile uint32_t  probe_end   = 0;         // SysTick in the callback
+
+uint64_t hal_time_us(void)
+{
+    return time_us_64();
+}
+
+void hal_gpio_inputs_pullup(uint32_t pins)
+{
+    gpio_init_mask(pins);       // SIO inputs, one register write for the direction
+    for (uint pin = 0; pins; pin++, pins >>= 1)
+    {
+        if (pins & 1)
+        {
+            gpio_pull_up(pin);  // the pads have no masked register
+        }
+    }
+}
+
+static void HAL_RAM_FUNC(gpio_irq_callback)(uint gpio, uint32_t events)
+{
+    if (probe_force && gpio == probe_pin)
+    {
+        probe_end = systick_hw->cvr;
+        hw_clear_bits(probe_force, probe_bit);
+        probe_force = nullptr;
+        return;
+    }
+
+    // Only stamp and queue the edge; debouncing happens in the main loop
+    edge_capture((uint8_t)gpio, gpio_get(gpio), time_us_64());
+    (void)events;
+}
+
+uint32_t hal_gpio_get_all(void)
+{
+    return gpio_get_all();
+}
+
+void hal_gpio_enable_edge_irqs(uint32_t pins)
+{
+    gpio_set_irq_callback(&gpio_irq_callback);
+    for (uint pin = 0; pins; pin++, pins >>= 1)
+    {
+        if (pins & 1)
+        {
+            gpio_set_irq_enabled(pin, GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE, true);
+        }
+    }
+    irq_set_enabled(IO_IRQ_BANK0, true);
+}
+
+// Turns each stamp back into time_us_64() time: the state machines count
+// the microseconds since edge_base_us, the clock the timer runs on, so an
+// edge is as old as the timer's count is ahead of its stamp.
+static void HAL_RAM_FUNC(edge_timer_irq)(void)
+{
+    for (uint sm = 0; sm < HAL_EDGE_TIMERS; sm++)
+    {
+        while ((edge_sms & (1u << sm)) && !pio_sm_is_rx_fifo_empty(edge_pio, sm))
+        {
+            uint32_t word   = pio_sm_get(edge_pio, sm);
+            uint32_t stamp  = (0u - (word >> 1)) & STAMP_MASK;  // X counts down from 0
+            uint64_t now_us = time_us_64();
+            uint32_t age    = ((uint32_t)(now_us - edge_base_us) - stamp) & STAMP_MASK;
+
+            // a stamp a hair ahead of the timer is an edge just now
+            if (age > STAMP_MASK / 2)
+            {
+                age = 0;
+            }
+            edge_capture(edge_pins[sm], word & 1, now_us - age);
+        }
+    }
+}
+
+void hal_gpio_enable_edge_timers(uint32_t pins)
+{
+    uint offset = pio_add_program(edge_pio, &edge_timer_program);
+    uint sm     = 0;
+    for (uint pin = 0; pins && sm < HAL_EDGE_TIMERS; pin++, pins >>= 1)
+    {
+        if (pins & 1)
+        {
+            edge_timer_program_init(edge_pio, sm, offset, pin);
+            pio_set_irq0_source_enabled(edge_pio, (pio_interrupt_source)(pis_sm0_rx_fifo_not_empty + sm), true);
+            edge_pins[sm] = (uint8_t)pin;
+            edge_sms |= 1u << sm++;
+        }
+    }
+    irq_set_exclusive_handler(PIO0_IRQ_0, edge_timer_irq);
+    irq_set_enabled(PIO0_IRQ_0, true);
+
+    edge_base_us = time_us_64();
+    pio_enable_sm_mask_in_sync(edge_pio, edge_sms);
+}
+
+// The raise is a write to this core's INTF register, so the time covers
+// the NVIC, the SDK dispatcher and the first fetches of the callback.
+void hal_gpio_irq_latency(uint8_t pin, uint8_t count, uint16_t *min_cycles, uint16_t *max_cycles)
+{
+    io_irq_ctrl_hw_t *ctrl = get_core_num() ? &iobank0_hw->proc1_irq_ctrl
+                                            : &iobank0_hw->proc0_irq_ctrl;
+
+    // SysTick is per core, core 0 runs its own for the DSP cycle counts
+    systick_hw->rvr = SYSTICK_MASK;
+    systick_hw->cvr = 0;
+    systick_hw->csr = 0x5;      // enabled, clk_sys, no interrupt
+
+    *min_cycles = UINT16_MAX;
+    *max_cycles = 0;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        probe_pin   = pin;
+        probe_bit   = GPIO_IRQ_EDGE_RISE << 4 * (pin % 8);
+        probe_force = &ctrl->intf[pin / 8];
+        uint32_t start = systick_hw->cvr;
+        hw_set_bits(&ctrl->intf[pin / 8], probe_bit);
+        while (probe_force)
+        {
+            tight_loop_contents();
+        }
+
+        uint32_t cycles = (start - probe_end) & SYSTICK_MASK;
+        cycles = cycles < UINT16_MAX ? cycles : UINT16_MAX;
+        if (cycles < *min_cycles) *min_cycles = (uint16_t)cycles;
+        if (cycles > *max_cycles) *max_cycles = (uint16_t)cycles;
+    }
+}
+
+bool HAL_RAM_FUNC(hal_hid_ready)(void)
+{
+    return tud_hid_ready();
+}
+
+bool HAL_RAM_FUNC(hal_hid_keyboard_report)(uint8_t report_id, uint8_t modifier, const uint8_t keycode[6])
+{
+    return tud_hid_keyboard_report(report_id, modifier, keycode);
+}
+
+bool HAL_RAM_FUNC(hal_hid_phone_report)(uint8_t report_id, uint8_t buttons)
+{
+    return tud_hid_report(report_id, &buttons, sizeof(buttons));
+}
+
+bool hal_usb_suspended(void)
+{
+    return tud_suspended();
+}
+
+void hal_usb_remote_wakeup(void)
+{
+    tud_remote_wakeup();
+}
+
+void hal_macro_started(uint8_t line)
+{
+    (void)line;
+}
+
+void hal_handset_off_hook(bool off_hook)
+{
+    speaker_set_off_hook(off_hook);
+}
+
+void hal_handset_digit(uint8_t digit)
+{
+    dtmf_start(digit);
+}
+
+void hal_reboot_to_bootloader(void)
+{
+    reset_usb_boot(1 << digitalPinToPinName(LED_BUILTIN), 0);
+}
+
+void hal_wake_other_core(void)
+{
+    __sev();
+}
+
+const uint8_t *hal_flash_store(void)
+{
+    return (const uint8_t *)(XIP_BASE + STORE_OFFSET);
+}
+
+// nothing may run from flash while it is being written, on either core
+// (both called multicore_lockout_victim_init() at start-up)
+void hal_flash_erase(uint32_t sector)
+{
+    multicore_lockout_start_blocking();
+    uint32_t ints = save_and_disable_interrupts();
+    flash_range_erase(STORE_OFFSET + sector * FLASH_SECTOR_SIZE, FLASH_SECTOR_SIZE);
+    restore_interrupts(ints);
+    multicore_lockout_end_blocking();
+}
+
+void hal_flash_program(uint32_t offset, const uint8_t page[HAL_FLASH_PAGE_SIZE])
+{
+    multicore_lockout_start_blocking();
+    uint32_t ints = save_and_disable_interrupts();
+    flash_range_program(STORE_OFFSET + offset, page, FLASH_PAGE_SIZE);
+    restore_interrupts(ints);
+    multicore_lockout_end_blocking();
+}
+
+void hal_flash_lock(void)
+{
+    mutex_enter_blocking(&store_mutex);
+}
+
+void hal_flash_unlock(void)
+{
+    mutex_exit(&store_mutex);
+}
@@ -0,0 +1,198 @@
+/**
+ * @file hid_queue.cpp
+ * @brief HID report scheduler, see hid_queue.h
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "hal.h"
+#include "hid_queue.h"
+#include "stats.h"
+#include "timers.h"
+#include "usb_descriptors.h"
+
+enum HidItemKind
+{
+    HID_ITEM_REPORT,
+    HID_ITEM_PHONE,
+    HID_ITEM_DELAY
+};
+
+struct HidItem
+{
+    uint8_t  kind;
+    uint8_t  line;      // whose keyboard or telephony collection
+    uint8_t  modifier;
+    uint16_t delay_ms;
+    uint8_t  keycode[6];
+    uint8_t  buttons;   // HID_ITEM_PHONE
+    uint8_t  latency;   // LatencyId to record on completion, or LATENCY_NONE
+    uint32_t origin_us; // low 32 bits of the time latency counts from
+};
+
+static HidItem  items[HID_QUEUE_SIZE];
+static uint32_t head = 0;          // next free slot
+static uint32_t tail = 0;          // next item to send
+static bool     in_flight = false; // report handed to the endpoint, not completed
+static bool     delaying  = false;
+static uint64_t delay_end_us = 0;
+
+static uint8_t  stamp_latency   = LATENCY_NONE;    // for the next report queued
+static uint32_t stamp_origin_us = 0;
+static uint8_t  sent_latency    = LATENCY_NONE;    // the report in flight
+static uint32_t sent_origin_us  = 0;
+static uint32_t sent_us         = 0;
+
+size_t hid_queue_free(void)
+{
+    return HID_QUEUE_SIZE - (head - tail);
+}
+
+static void push(const HidItem &item)
+{
+    HidItem &slot = items[head % HID_QUEUE_SIZE];
+    slot = item;
+    slot.latency = LATENCY_NONE;
+    if (item.kind != HID_ITEM_DELAY && stamp_latency != LATENCY_NONE)
+    {
+        slot.latency    = stamp_latency;
+        slot.origin_us  = stamp_origin_us;
+        stamp_latency   = LATENCY_NONE;
+    }
+    ++head;
+}
+
+void hid_queue_stamp(uint8_t latency, uint64_t origin_us)
+{
+    stamp_latency   = latency;
+    stamp_origin_us = (uint32_t)origin_us;
+}
+
+bool hid_queue_report(uint8_t line, uint8_t modifier, const uint8_t keycode[6])
+{
+    if (hid_queue_free() < 1)
+    {
+        stats_count(COUNTER_HID_DROPS);
+        return false;
+    }
+
+    HidItem item = { HID_ITEM_REPORT, line, modifier, 0, {0} };
+    if (keycode)
+    {
+        memcpy(item.keycode, keycode, sizeof(item.keycode));
+    }
+    push(item);
+    return true;
+}
+
+bool hid_queue_key(uint8_t line, uint8_t modifier, uint8_t keycode)
+{
+    if (hid_queue_free() < 2)
+    {
+        stats_count(COUNTER_HID_DROPS);
+        return false;
+    }
+
+    HidItem press = { HID_ITEM_REPORT, line, modifier, 0, { keycode, 0, 0, 0, 0, 0 } };
+    push(press);
+    hid_queue_report(line, 0, NULL);                    // release
+    return true;
+}
+
+bool hid_queue_phone(uint8_t line, uint8_t buttons)
+{
+    if (hid_queue_free() < 1)
+    {
+        stats_count(COUNTER_HID_DROPS);
+        return false;
+    }
+
+    HidItem item = { HID_ITEM_PHONE, line, 0, 0, {0}, buttons };
+    push(item);
+    return true;
+}
+
+bool hid_queue_delay(uint16_t delay_ms)
+{
+    if (hid_queue_free() < 1)
+    {
+        stats_count(COUNTER_HID_DROPS);
+        return false;
+    }
+
+    HidItem item = { HID_ITEM_DELAY, 0, 0, delay_ms, {0} };
+    push(item);
+    return true;
+}
+
+static void pump(void);
+
+static void HAL_RAM_FUNC(pause_over)(uint64_t due_us)
+{
+    (void)due_us;
+    pump();
+}
+
+// Send the next report if nothing is in flight; pauses are waited out
+// here too, counted from the completion of the report before them.
+static void HAL_RAM_FUNC(pump)(void)
+{
+    while (!in_flight && tail != head)
+    {
+        HidItem &item = items[tail % HID_QUEUE_SIZE];
+
+        if (item.kind == HID_ITEM_DELAY)
+        {
+            if (!delaying)
+            {
+                delaying     = true;
+                delay_end_us = hal_time_us() + item.delay_ms * 1000u;
+                timer_at(TIMER_HID_PAUSE, delay_end_us, pause_over);
+            }
+            if (hal_time_us() < delay_end_us)
+            {
+                return;
+            }
+            delaying = false;
+            ++tail;
+            continue;
+        }
+
+        bool sent = hal_hid_ready() &&
+                    (item.kind == HID_ITEM_PHONE
+                         ? hal_hid_phone_report(report_id_telephony(item.line), item.buttons)
+                         : hal_hid_keyboard_report(report_id_keyboard(item.line), item.modifier, item.keycode));
+        if (!sent)
+        {
+            return;                     // endpoint busy, retried from hid_queue_task()
+        }
+        in_flight      = true;
+        sent_us        = (uint32_t)hal_time_us();
+        sent_latency   = item.latency;
+        sent_origin_us = item.origin_us;
+        ++tail;
+    }
+}
+
+void HAL_RAM_FUNC(hid_queue_task)(void)
+{
+    stamp_latency = LATENCY_NONE;   // nothing was queued after the stamp
+    pump();
+}
+
+void HAL_RAM_FUNC(hid_queue_report_complete)(void)
+{
+    if (in_flight)
+    {
+        // the host has the report now; 32-bit differences survive the wrap
+        uint32_t now_us = (uint32_t)hal_time_us();
+        stats_latency(LATENCY_HID_EP, now_us - sent_us);
+        if (sent_latency != LATENCY_NONE)
+        {
+            stats_latency((LatencyId)sent_latency, now_us - sent_origin_us);
+        }
+    }
+    in_flight = false;
+    pump();
+}
@@ -0,0 +1,46 @@
+/**
+ * @file hid_queue.h
+ * @brief one shared, fixed-capacity queue of HID reports and pauses
+ *
+ * Every producer (dial, hook, keyboard scan) enqueues here instead of
+ * talking to the endpoint. The queue sends one report, then the next one
+ * goes out straight from tud_hid_report_complete_cb(), i.e. on the next
+ * interrupt frame the host polls. hid_queue_task() only has to restart it
+ * when it was idle or a pause has run out.
+ */
+
+#ifndef HID_QUEUE_H
+#define HID_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HID_QUEUE_SIZE 32   // items, a key tap takes two
+
+// Reports go to the keyboard or telephony collection of line (below
+// DIAL_LINES, usb_descriptors.h); the lines share the queue and its order.
+
+// Press modifier + keycode and release it again. Both reports are queued
+// or neither is, so a full queue never leaves a key stuck down.
+bool hid_queue_key(uint8_t line, uint8_t modifier, uint8_t keycode);
+
+// Queue one raw keyboard report (keycode may be NULL for "all released")
+bool hid_queue_report(uint8_t line, uint8_t modifier, const uint8_t keycode[6]);
+
+// Queue one telephony input report (PHONE_* bits, phone.h)
+bool hid_queue_phone(uint8_t line, uint8_t buttons);
+
+// Hold back the following items for delay_ms after the previous report
+bool hid_queue_delay(uint16_t delay_ms);
+
+// Record, in histogram latency (a LatencyId, stats.h), the time from
+// origin_us until the host picks up the next report queued. Forgotten if
+// nothing is queued before the next hid_queue_task().
+void hid_queue_stamp(uint8_t latency, uint64_t origin_us);
+
+size_t hid_queue_free(void);
+
+void hid_queue_task(void);             // (re)start sending from the main loop
+void hid_queue_report_complete(void);  // call from tud_hid_report_complete_cb()
+
+#endif /* HID_QUEUE_H */
@@ -3,13 +3,19 @@
  * @author @rktrlng
  * @brief create USB HID keycodes from pin inputs
  * @see https://github.com/rktrlng/pico_tusb_keyboard
+ *
+ * The pin map is a constexpr table; the masks and the pin -> keycode and
+ * pin -> modifier lookups are built from it at compile time. The pins are
+ * debounced with the dial and hook (dialer.cpp), so an update is an XOR of
+ * the debounced levels against the last ones, and a walk over the pressed
+ * bits only when something changed.
  */
 
 #ifndef KEYS_H
 #define KEYS_H
 
-#include "hardware/gpio.h" // gpio_*
-#include "class/hid/hid.h" // HID_KEY_*
+#include "hal.h" // hal_gpio_*, HID_KEY_*
+#include "usb_descriptors.h" // DIAL_LINES
 
 struct PinKey
 {
@@ -17,85 +23,138 @@ struct PinKey
 	const uint8_t key; // HID_KEY_*
 };
 
+// ===========================================================================
+#define KEY_DEBOUNCE_MS 5 // a press or release must be this stable, 1-63
+
+// set these values to your situation; pins the dial, hook and audio use
+// (13, 16, 26, 27) are taken, main.cpp checks the map against them. Every
+// header pin is in use, so each phone past the first takes two keys'
+// pins for its dial and hook, from GPIO 17 up (LINE_KEY_PINS).
+static constexpr PinKey pin_keys[] = { // map gpio pin to keycode
+	{0, HID_KEY_1},             // 1 player
+	{1, HID_KEY_5},             // coin slot 1
+	{2, HID_KEY_ARROW_UP},
+	{3, HID_KEY_ARROW_DOWN},
+	{4, HID_KEY_ARROW_LEFT},
+	{5, HID_KEY_ARROW_RIGHT},
+	{6, HID_KEY_E},             // up (left stick)
+	{7, HID_KEY_D},             // down (left stick)
+	{8, HID_KEY_S},             // left (left stick)
+	{9, HID_KEY_F},             // right (left stick)
+	{10, HID_KEY_I},            // up (right stick)
+	{11, HID_KEY_K},            // down (right stick)
+	{12, HID_KEY_J},            // left (right stick)
+	{14, HID_KEY_CONTROL_LEFT}, // button 1
+	{15, HID_KEY_ALT_LEFT},     // button 2
+	{17, HID_KEY_SHIFT_LEFT},   // button 4
+	{18, HID_KEY_Z},            // button 5
+	{19, HID_KEY_X},            // button 6
+	{20, HID_KEY_C},            // button 7
+	{21, HID_KEY_V},            // button 8
+	{22, HID_KEY_ENTER},        // select
+	{28, HID_KEY_BACKSPACE}
+};
+// ===========================================================================
+
+// the key pins the extra lines are free to take, 17-18 for line 1 and so on
+#define LINE_KEY_PINS (((1u << (2 * (DIAL_LINES - 1))) - 1) << 17)
+
+struct KeyMap
+{
+	uint32_t key_mask = 0;      // pins in pin_keys, less LINE_KEY_PINS
+	uint32_t mod_mask = 0;      // those of them that are modifiers
+	uint8_t  key[32]  = {0};    // HID_KEY_* by pin
+	uint8_t  mod[32]  = {0};    // KEYBOARD_MODIFIER_* by pin
+};
+
+static constexpr KeyMap key_map_build()
+{
+	KeyMap m;
+	for (const PinKey &pk : pin_keys)
+	{
+		if (LINE_KEY_PINS & (1u << pk.pin))
+		{
+			continue;
+		}
+		m.key_mask |= 1u << pk.pin;
+		if (pk.key >= HID_KEY_CONTROL_LEFT && pk.key <= HID_KEY_GUI_RIGHT)
+		{
+			m.mod_mask   |= 1u << pk.pin;
+			m.mod[pk.pin] = (uint8_t)(1u << (pk.key - HID_KEY_CONTROL_LEFT));
+		}
+		else
+		{
+			m.key[pk.pin] = pk.key;
+		}
+	}
+	return m;
+}
+
+static constexpr bool key_map_valid()
+{
+	uint32_t seen = 0;
+	for (const PinKey &pk : pin_keys)
+	{
+		if (pk.pin >= 30 || (seen & (1u << pk.pin)))
+		{
+			return false;
+		}
+		seen |= 1u << pk.pin;
+	}
+	return true;
+}
+static_assert(key_map_valid(), "each pin once, GPIO 0-29");
+
+static constexpr KeyMap key_map = key_map_build();
+
 class KeyBoard
 {
 private:
-	// ===========================================================================
-	// set these values to your situation
-	const static size_t num_pins = 26;
-	const PinKey pin_keys[num_pins] = { // map gpio pin to keycode
-		{0, HID_KEY_1},             // 1 player
-		{1, HID_KEY_5},             // coin slot 1
-		{2, HID_KEY_ARROW_UP},
-		{3, HID_KEY_ARROW_DOWN},
-		{4, HID_KEY_ARROW_LEFT},
-		{5, HID_KEY_ARROW_RIGHT},
-		{6, HID_KEY_E},             // up (left stick)
-		{7, HID_KEY_D},             // down (left stick)
-		{8, HID_KEY_S},             // left (left stick)
-		{9, HID_KEY_F},             // right (left stick)
-		{10, HID_KEY_I},            // up (right stick)
-		{11, HID_KEY_K},            // down (right stick)
-		{12, HID_KEY_J},            // left (right stick)
-		{13, HID_KEY_L},            // right (right stick)
-		{14, HID_KEY_CONTROL_LEFT}, // button 1
-		{15, HID_KEY_ALT_LEFT},     // button 2
-		{16, HID_KEY_SPACE},        // button 3
-		{17, HID_KEY_SHIFT_LEFT},   // button 4
-		{18, HID_KEY_Z},            // button 5
-		{19, HID_KEY_X},            // button 6
-		{20, HID_KEY_C},            // button 7
-		{21, HID_KEY_V},            // button 8
-		{22, HID_KEY_ENTER},        // select
-		{26, HID_KEY_ESCAPE},       // back
-		{27, HID_KEY_SHIFT_RIGHT},
-		{28, HID_KEY_BACKSPACE}
-	};
-	// ===========================================================================
+	uint32_t pressed = 0; // key pins held down at the last scan
 
 public:
+	static constexpr uint32_t key_mask = key_map.key_mask;
+
+	uint8_t modifier = 0;
 	uint8_t key_codes[6] = {0}; // we can send max 6 keycodes per hid-report
 
-	KeyBoard()
+	// levels are the debounced pin levels; true if any key went down or up
+	// since the last call, modifier and key_codes then hold the new state
+	// (first six keys by pin number)
+	bool update(uint32_t levels)
 	{
-		// set all pins to pulled up inputs
-		for (size_t i = 0; i < num_pins; i++)
+		uint32_t now = ~levels & key_mask; // pressed = LOW
+		if (!(now ^ pressed))
 		{
-			gpio_init(pin_keys[i].pin);
-			gpio_pull_up(pin_keys[i].pin);
-			gpio_set_dir(pin_keys[i].pin, GPIO_IN);
+			return false;
 		}
-	}
+		pressed = now;
 
-	virtual ~KeyBoard() {}
-
-	bool update()
-	{
-		// clear keycodes
-		for (size_t i = 0; i < 6; i++)
+		modifier = 0;
+		uint32_t mods = now & key_map.mod_mask;
+		while (mods)
 		{
-			key_codes[i] = 0;
+			modifier |= key_map.mod[__builtin_ctz(mods)];
+			mods &= mods - 1;
 		}
 
-		// read pins and set max 6 keycodes
-		uint8_t index = 0;
-		bool changed = false;
-		for (size_t i = 0; i < num_pins; i++)
+		uint8_t  index = 0;
+		uint32_t keys  = now & ~key_map.mod_mask;
+		while (keys && index < 6)
 		{
-			int pin_state = gpio_get(pin_keys[i].pin); // read pin for this key
-			if (pin_state == 0) // pressed
-			{
-				key_codes[index] = pin_keys[i].key; // set keycode
-				changed = true;
-				index++;
-				if (index >= 6) // max is 6 key presses
-				{
-					break;
-				}
-			}
+			key_codes[index++] = key_map.key[__builtin_ctz(keys)];
+			keys &= keys - 1;
 		}
+		while (index < 6)
+		{
+			key_codes[index++] = 0;
+		}
+		return true;
+	}
 
-		return changed;
+	bool any_pressed() const
+	{
+		return pressed != 0;
 	}
 };
 
@@ -0,0 +1,115 @@
+/**
+ * @file macro.cpp
+ * @brief built-in macro tables and their interpreter, see macro.h
+ */
+
+#include <stddef.h>
+
+#include "hal.h"
+#include "macro.h"
+#include "hid_queue.h"
+#include "stats.h"
+#include "usb_descriptors.h"
+
+struct Macro
+{
+    const MacroStep *steps;
+    uint8_t          length;
+};
+
+// Queue items a macro needs: press + release per step, plus the pauses
+static constexpr size_t macro_items(size_t length)
+{
+    return length * 3 - 1;
+}
+
+template <size_t N>
+static constexpr bool macro_valid(const MacroStep (&steps)[N])
+{
+    if (macro_items(N) > HID_QUEUE_SIZE)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < N; i++)
+    {
+        // modifiers belong in .modifier, a bare modifier key would stick
+        if (steps[i].keycode == 0 || steps[i].keycode >= HID_KEY_CONTROL_LEFT)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// ===========================================================================
+// built-in macros
+static constexpr MacroStep hang_up_steps[] = {
+    { KEYBOARD_MODIFIER_LEFTALT,  HID_KEY_Q,     MACRO_GAP },  // Zoom: leave
+    { 0,                          HID_KEY_ENTER, MACRO_GAP },  // Zoom: confirm
+    { KEYBOARD_MODIFIER_LEFTCTRL, HID_KEY_W,     MACRO_GAP },  // Meet: close tab
+    { KEYBOARD_MODIFIER_LEFTCTRL |
+      KEYBOARD_MODIFIER_LEFTSHIFT, HID_KEY_H,    MACRO_GAP },  // Teams: hang up
+};
+
+static constexpr MacroStep answer_steps[] = {
+    { KEYBOARD_MODIFIER_LEFTCTRL |
+      KEYBOARD_MODIFIER_LEFTSHIFT, HID_KEY_S,    MACRO_GAP },  // Teams: accept audio
+};
+// ===========================================================================
+
+static_assert(macro_valid(hang_up_steps), "bad hang-up macro");
+static_assert(macro_valid(answer_steps),  "bad answer macro");
+
+#define MACRO_ENTRY(steps) { steps, sizeof(steps) / sizeof(steps[0]) }
+
+static constexpr Macro macros[] = {
+    MACRO_ENTRY(hang_up_steps),     // MACRO_HANG_UP
+    MACRO_ENTRY(answer_steps),      // MACRO_ANSWER
+};
+static_assert(sizeof(macros) / sizeof(macros[0]) == MACRO_COUNT, "one table per MacroId");
+
+static uint8_t  gap_ms = 20;
+static bool     ran[DIAL_LINES];
+static uint64_t last_run_us[DIAL_LINES];
+
+void macro_set_gap_ms(uint8_t ms)
+{
+    gap_ms = ms == MACRO_GAP ? MACRO_GAP - 1 : ms;
+}
+
+bool macro_run(uint8_t line, MacroId id)
+{
+    if (id >= MACRO_COUNT)
+    {
+        return false;
+    }
+
+    uint64_t now_us = hal_time_us();
+    if (ran[line] && now_us - last_run_us[line] < MACRO_MIN_INTERVAL_MS * 1000ull)
+    {
+        return false;
+    }
+
+    const Macro &m = macros[id];
+    if (hid_queue_free() < macro_items(m.length))
+    {
+        stats_count(COUNTER_HID_DROPS);
+        return false;               // never send half a macro
+    }
+    ran[line]         = true;
+    last_run_us[line] = now_us;
+    hal_macro_started(line);
+
+    for (uint8_t i = 0; i < m.length; i++)
+    {
+        const MacroStep &step = m.steps[i];
+        hid_queue_key(line, step.modifier, step.keycode);
+
+        uint8_t delay = step.delay_ms == MACRO_GAP ? gap_ms : step.delay_ms;
+        if (i + 1 < m.length && delay)
+        {
+            hid_queue_delay(delay);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,42 @@
+/**
+ * @file macro.h
+ * @brief keyboard shortcut macros as data, played through the HID queue
+ *
+ * A macro is a constexpr table of key taps, each followed by a pause.
+ * The tables live in macro.cpp and are checked at compile time; adding a
+ * macro adds a few bytes of table and no code.
+ */
+
+#ifndef MACRO_H
+#define MACRO_H
+
+#include <stdint.h>
+
+#define MACRO_GAP 0xFF  // step delay: use the configurable gap (macro_set_gap_ms)
+#define MACRO_MIN_INTERVAL_MS 1000  // between the starts of two macros
+
+struct MacroStep
+{
+    uint8_t modifier;   // KEYBOARD_MODIFIER_*
+    uint8_t keycode;    // HID_KEY_*, never a modifier key
+    uint8_t delay_ms;   // pause after this tap, or MACRO_GAP
+};
+
+enum MacroId
+{
+    MACRO_HANG_UP,      // leave the call in Zoom, Meet and Teams
+    MACRO_ANSWER,       // accept an incoming call
+    MACRO_COUNT
+};
+
+// Queue every step of a macro to line's keyboard, or nothing if the queue
+// can't hold it all or the line's last macro started less than
+// MACRO_MIN_INTERVAL_MS ago (a flapping hook switch would otherwise fire
+// one per flap)
+bool macro_run(uint8_t line, MacroId id);
+
+// Pause between steps that use MACRO_GAP, 20 ms by default. Lower it for
+// hosts that keep up, raise it for slow ones.
+void macro_set_gap_ms(uint8_t gap_ms);
+
+#endif /* MACRO_H */
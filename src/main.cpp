@@ -28,89 +28,139 @@
 #include <string.h>
 
 #include "bsp/board.h"
+#include "pico/multicore.h"
+#include "pico/time.h"
 #include "tusb.h"
 
 #include "usb_descriptors.h"
+#include "config.h"
+#include "dialer.h"
+#include "dsp.h"
+#include "hal.h"
+#include "hid_queue.h"
 #include "keyboard.h"
-#include "hardware/gpio.h"
-#include "hardware/irq.h"
-extern "C" {
-#include "pico/bootrom.h"
+#include "mic.h"
+#include "phone.h"
+#include "speaker.h"
+#include "power.h"
+#include "stats.h"
+#include "timers.h"
+#include "usb_audio.h"
+
+static_assert(sizeof(LatencyHistogram) == STATS_LATENCY_REPORT_LEN, "descriptor out of date");
+static_assert(sizeof(StatsCounters) == STATS_COUNTERS_REPORT_LEN, "descriptor out of date");
+static_assert(sizeof(StatsPower) == STATS_POWER_REPORT_LEN, "descriptor out of date");
+static_assert(sizeof(StatsDsp) == STATS_DSP_REPORT_LEN, "descriptor out of date");
+static_assert(sizeof(Config) == CONFIG_REPORT_LEN, "descriptor out of date");
+
+// each feature report, stats and settings alike, goes through the HID
+// buffer with its ID in front; the only check that they all fit
+static constexpr uint32_t feature_report_lens[] = {
+    STATS_LATENCY_REPORT_LEN, STATS_COUNTERS_REPORT_LEN, STATS_POWER_REPORT_LEN,
+    STATS_DSP_REPORT_LEN, SIDETONE_REPORT_LEN, CONFIG_REPORT_LEN,
+};
+
+static constexpr bool feature_reports_fit(void)
+{
+    for (uint32_t len : feature_report_lens)
+    {
+        if (1 + len > CFG_TUD_HID_EP_BUFSIZE) return false;
+    }
+    return true;
 }
 
-// -----------------------------------------------------------------
-// Arduino-compat helpers for reset_usb_boot() call
-#ifndef LED_BUILTIN
-#include "pico/stdlib.h"
-#define LED_BUILTIN PICO_DEFAULT_LED_PIN   // map to Pico's on-board LED
-#endif
-
-static inline uint digitalPinToPinName(uint pin) { return pin; }
-// -----------------------------------------------------------------
-
-
-//--------------------------------------------------------------------+
-// MACRO CONSTANT TYPEDEF PROTYPES
-//--------------------------------------------------------------------+
+static_assert(feature_reports_fit(), "a feature report doesn't fit CFG_TUD_HID_EP_BUFSIZE");
 
+// boot milestones for report 7, see StatsPower
+static uint32_t          boot_main_us;
+static uint32_t          boot_usb_us;
+static uint32_t          boot_mount_us;
+static volatile uint16_t irq_entry_cycles[2];   // written once by core 1
 
-// ---------------  PULSE-COUNT INPUT ----------------
-#define PULSE_PIN          27      // free GPIO used for pulse train
-#define PULSE_DEBOUNCE_MS    5      // match back-ported debounce
-volatile uint32_t pulse_count      = 0;   // #edges since last send
-volatile uint32_t last_pulse_time  = 0;   // ms timestamp of last **accepted** edge
-// ---------------------------------------------------
+// keys must stay off the pins the phone itself uses
+static_assert(!(KeyBoard::key_mask & (1u << PULSE_PIN | 1u << HANGUP_PIN | 1u << MIC_PIN | 1u << EARPIECE_PIN)),
+              "pin_keys uses a reserved pin");
+#ifdef DUTY_CYCLE_PIN
+static_assert(!(KeyBoard::key_mask & (3u << DUTY_CYCLE_PIN)), "pin_keys uses a duty cycle pin");
+#endif
 
-// ---------------  HANG-UP INPUT -----------------
-#define HANGUP_PIN          13        // unused GPIO, pulled-up HIGH
-// ------------------------------------------------
+// and the dial and hook can only be moved to a pin nothing else uses.
+// On a Pico, GPIO 23 (regulator power save), 24 (VBUS sense), 25 (LED) and
+// 29 (VSYS sense) are wired on the board and don't reach the header.
+#if defined(RASPBERRYPI_PICO) || defined(RASPBERRYPI_PICO_W)
+#define BOARD_PINS (1u << 23 | 1u << 24 | 1u << 25 | 1u << 29)
+#else
+#define BOARD_PINS 0u
+#endif
+#ifdef DUTY_CYCLE_PIN
+#define CONFIG_RESERVED_PINS (KeyBoard::key_mask | 1u << MIC_PIN | 1u << EARPIECE_PIN | BOARD_PINS | 3u << DUTY_CYCLE_PIN)
+#else
+#define CONFIG_RESERVED_PINS (KeyBoard::key_mask | 1u << MIC_PIN | 1u << EARPIECE_PIN | BOARD_PINS)
+#endif
 
-void hid_task(void);
-void pulse_task(void);
-void hangup_task(void);
-void gpio_irq_callback(uint gpio, uint32_t events);
+#define REPORT_ID_STATS_LAST REPORT_ID_STATS_DSP
 
-KeyBoard keyboard;
+// the histogram behind a stats report ID, LATENCY_NONE for the others
+static uint8_t report_latency(uint8_t report_id)
+{
+    switch (report_id)
+    {
+    case REPORT_ID_STATS_DIGIT:  return LATENCY_DIGIT;
+    case REPORT_ID_STATS_HOOK:   return LATENCY_HOOK;
+    case REPORT_ID_STATS_HID_EP: return LATENCY_HID_EP;
+    case REPORT_ID_STATS_MIC:    return LATENCY_MIC;
+    default:                     return LATENCY_NONE;
+    }
+}
 
-void gpio_irq_callback(uint gpio, uint32_t events)
+/*------------- CORE 1: dial and hook decoding -------------*/
+static void core1_main(void)
 {
-  if (gpio == PULSE_PIN && (events & GPIO_IRQ_EDGE_FALL))
-  {
-    uint32_t now = board_millis();
+    multicore_lockout_victim_init(); // hold still while core 0 writes flash
+    power_init();
+    dialer_init();                   // edge interrupts land on this core
 
-    // Accept this edge only if it is at least PULSE_DEBOUNCE_MS after
-    // the previous accepted one
-    if ((uint32_t)(now - last_pulse_time) >= PULSE_DEBOUNCE_MS)
+    uint16_t fastest, slowest;
+    hal_gpio_irq_latency((uint8_t)config.hangup_pin, STATS_IRQ_PROBES, &fastest, &slowest);
+    irq_entry_cycles[0] = fastest;
+    irq_entry_cycles[1] = slowest;
+
+    while (1)
     {
-      ++pulse_count;          // valid pulse
-      last_pulse_time = now;  // remember when it occurred
+        edge_task();             // feed captured edges to the debouncer
+        timers_run(1, time_us_64()); // debounce ticks, end of digit
+
+        // nothing left to do until a timer or the next edge
+        power_sleep_until(timers_next_us(1));
     }
-  }
 }
 
 /*------------- MAIN -------------*/
 int main(void)
 {
+    boot_main_us = time_us_32();
     board_init();
-    // ---------- pulse counter pin --------------
-    gpio_init(PULSE_PIN);
-    gpio_pull_up(PULSE_PIN);                       // idle = high, pulse = low
-    gpio_set_dir(PULSE_PIN, GPIO_IN);
-    // -------------------------------------------
-    // ---------- hang-up pin --------------
-    gpio_init(HANGUP_PIN);
-    gpio_pull_up(HANGUP_PIN);            // idle = HIGH, active = LOW
-    gpio_set_dir(HANGUP_PIN, GPIO_IN);
-    // ------------------------------------
+    multicore_lockout_victim_init(); // hold still while core 1 writes flash
+    config_load(CONFIG_RESERVED_PINS);
+    power_init();
+    dsp_init();
+    mic_init();
+    speaker_init();
+    multicore_launch_core1(core1_main);
     tusb_init();
+    boot_usb_us = time_us_32();
 
     while (1)
     {
         tud_task(); // tinyusb device task
 
-        pulse_task();            // NEW : converts pulse train to one keystroke
-        hangup_task();         // NEW : sends Ctrl-W on off-hook
-        // hid_task(); // keyboard implementation
+        dial_event_task();       // digits and hook changes from core 1
+        hid_task();              // keyboard implementation
+        hid_queue_task();        // restart queued reports after idle
+        timers_run(0, time_us_64()); // end of HID queue pauses
+
+        // nothing left to do until a timer, an interrupt or core 1
+        power_sleep_until(timers_next_us(0));
     }
 
     return 0;
@@ -120,86 +170,97 @@ int main(void)
 // USB HID
 //--------------------------------------------------------------------+
 
-static void send_hid_report(bool keys_pressed)
+// Invoked when sent REPORT successfully to host
+// Application can use this to send the next report
+// Note: For composite reports, report[0] is report ID
+void HAL_RAM_FUNC(tud_hid_report_complete_cb)(uint8_t instance, uint8_t const *report, uint8_t len)
 {
-    // skip if hid is not ready yet
-    if (!tud_hid_ready())
-    {
-        return;
-    }
+    // the endpoint is free again, send the next queued report right away
+    (void)instance;
+    (void)report;
+    (void)len;
+    hid_queue_report_complete();
+}
 
-    // avoid sending multiple zero reports
-    static bool send_empty = false;
+// Invoked when received GET_REPORT control request
+// Application must fill buffer report's content and return its length.
+// Return zero will cause the stack to STALL request
+uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t *buffer, uint16_t reqlen)
+{
+    (void)instance;
 
-    if (keys_pressed)
+    if (report_type == HID_REPORT_TYPE_FEATURE && report_id == REPORT_ID_SIDETONE &&
+        reqlen >= SIDETONE_REPORT_LEN)
     {
-        tud_hid_keyboard_report(REPORT_ID_KEYBOARD, 0, keyboard.key_codes);
-        send_empty = true;
+        int16_t level = speaker_sidetone();
+        memcpy(buffer, &level, sizeof(level));
+        return sizeof(level);
     }
-    else
+
+    if (report_type == HID_REPORT_TYPE_FEATURE && report_id == REPORT_ID_CONFIG &&
+        reqlen >= CONFIG_REPORT_LEN)
     {
-        // send empty key report if previously has key pressed
-        if (send_empty)
-        {
-            tud_hid_keyboard_report(REPORT_ID_KEYBOARD, 0, NULL);
-        }
-        send_empty = false;
+        memcpy(buffer, &config, sizeof(config));
+        return sizeof(config);
     }
-}
 
-// Every 10ms, we poll the pins and send a report
-void hid_task(void)
-{
-    // Poll every 10ms
-    const uint32_t interval_ms = 10;
-    static uint32_t start_ms = 0;
-
-    if (board_millis() - start_ms < interval_ms)
+    if (report_type != HID_REPORT_TYPE_FEATURE ||
+        report_id < REPORT_ID_STATS_DIGIT || report_id > REPORT_ID_STATS_LAST)
     {
-        return; // not enough time
+        return 0;
     }
-    start_ms += interval_ms;
 
-    // Check for keys pressed
-    bool const keys_pressed = keyboard.update();
+    LatencyHistogram histogram;
+    StatsCounters    counters;
+    StatsPower       power;
+    StatsDsp         dsp;
+    const void      *report;
+    uint16_t         len;
+    uint8_t          latency = report_latency(report_id);
 
-    // Remote wakeup
-    if (tud_suspended() && keys_pressed)
+    if (latency != LATENCY_NONE)
+    {
+        stats_read_latency((LatencyId)latency, &histogram);
+        report = &histogram;
+        len    = sizeof(histogram);
+    }
+    else if (report_id == REPORT_ID_STATS_COUNTERS)
     {
-        // Wake up host if we are in suspend mode
-        // and REMOTE_WAKEUP feature is enabled by host
-        tud_remote_wakeup();
+        stats_read_counters(&counters);
+        report = &counters;
+        len    = sizeof(counters);
+    }
+    else if (report_id == REPORT_ID_STATS_DSP)
+    {
+        dsp_read_cycles(&dsp);
+        report = &dsp;
+        len    = sizeof(dsp);
     }
     else
     {
-        // send a report
-        send_hid_report(keys_pressed);
+        power.uptime_ms = (uint32_t)(time_us_64() / 1000);
+        for (uint8_t core = 0; core < 2; core++)
+        {
+            uint64_t awake_us, asleep_us;
+            power_stats(core, &awake_us, &asleep_us);
+            power.awake_ms[core]  = (uint32_t)(awake_us / 1000);
+            power.asleep_ms[core] = (uint32_t)(asleep_us / 1000);
+        }
+        power.boot_main_us        = boot_main_us;
+        power.boot_usb_us         = boot_usb_us;
+        power.boot_mount_us       = boot_mount_us;
+        power.irq_entry_cycles[0] = irq_entry_cycles[0];
+        power.irq_entry_cycles[1] = irq_entry_cycles[1];
+        report = &power;
+        len    = sizeof(power);
     }
-}
 
-// Invoked when sent REPORT successfully to host
-// Application can use this to send the next report
-// Note: For composite reports, report[0] is report ID
-void tud_hid_report_complete_cb(uint8_t instance, uint8_t const *report, uint8_t len)
-{
-    // not implemented, we only send REPORT_ID_KEYBOARD
-    (void)instance;
-    (void)len;
-}
-
-// Invoked when received GET_REPORT control request
-// Application must fill buffer report's content and return its length.
-// Return zero will cause the stack to STALL request
-uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t *buffer, uint16_t reqlen)
-{
-    // TODO not Implemented
-    (void)instance;
-    (void)report_id;
-    (void)report_type;
-    (void)buffer;
-    (void)reqlen;
-
-    return 0;
+    if (len > reqlen)
+    {
+        len = reqlen;
+    }
+    memcpy(buffer, report, len);
+    return len;
 }
 
 // Invoked when received SET_REPORT control request or
@@ -208,6 +269,39 @@ void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_
 {
     (void)instance;
 
+    // writing any stats report starts a new measurement, writing the DSP
+    // one also switches the stages
+    if (report_type == HID_REPORT_TYPE_FEATURE &&
+        report_id >= REPORT_ID_STATS_DIGIT && report_id <= REPORT_ID_STATS_LAST)
+    {
+        if (report_id == REPORT_ID_STATS_DSP && bufsize >= 1)
+        {
+            dsp_set_stages(buffer[0]);
+        }
+        stats_reset();
+        dsp_reset_cycles();
+        return;
+    }
+
+    if (report_type == HID_REPORT_TYPE_FEATURE && report_id == REPORT_ID_SIDETONE &&
+        bufsize >= SIDETONE_REPORT_LEN)
+    {
+        int16_t level;
+        memcpy(&level, buffer, sizeof(level));
+        speaker_set_sidetone(level);
+        return;
+    }
+
+    // store the fields that changed, see config_set_all()
+    if (report_type == HID_REPORT_TYPE_FEATURE && report_id == REPORT_ID_CONFIG &&
+        bufsize >= CONFIG_REPORT_LEN)
+    {
+        Config incoming;
+        memcpy(&incoming, buffer, sizeof(incoming));
+        config_set_all(incoming);
+        return;
+    }
+
     if (report_type == HID_REPORT_TYPE_OUTPUT)
     {
         // Set keyboard LED e.g Capslock, Numlock etc...
@@ -220,6 +314,25 @@ void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_
             uint8_t const kbd_leds = buffer[0];
             (void)kbd_leds;
         }
+        // Call state from the meeting app, per line; the Pico's LED
+        // shows whether any line rings or has a call
+        else if (bufsize >= 1)
+        {
+            uint8_t any = 0;
+            for (uint8_t line = 0; line < DIAL_LINES; line++)
+            {
+                if (report_id == report_id_telephony(line))
+                {
+                    phone_set_leds(line, buffer[0]);
+                    if (line == 0)
+                    {
+                        usb_audio_set_call_mute(buffer[0] & PHONE_LED_MUTE);
+                    }
+                }
+                any |= phone_leds(line);
+            }
+            board_led_write(any & (PHONE_LED_RING | PHONE_LED_OFF_HOOK));
+        }
     }
 }
 
@@ -227,248 +340,30 @@ void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_
 // Device callbacks
 //--------------------------------------------------------------------+
 
-void tud_mount_cb(void) {}
-void tud_umount_cb(void) {}
-void tud_suspend_cb(bool) {}
-void tud_resume_cb(void) {}
-
-static inline uint8_t ascii_to_key(char c)            // lower/upper A-Z only
+// a bus reset drops any report in flight without completing it
+void tud_mount_cb(void)
 {
-  if (c >= 'a' && c <= 'z') return HID_KEY_A + (c - 'a');
-  if (c >= 'A' && c <= 'Z') return HID_KEY_A + (c - 'A');
-  return 0;
-}
-
-void pulse_task(void)
-{
-  /* ---------- debouncer state --------------------------------- */
-  static bool     init             = false;
-  static bool     debounced_state  = true;   // last stable level
-  static bool     instant_state    = true;   // last raw sample
-  static uint32_t debounce_start   = 0;      // ms when a change started
-  /* ---------- key-sending state -------------------------------- */
-  /* ---------- rolling "1234" detector -------------------------- */
-  static uint8_t last4[4] = { 0xFF, 0xFF, 0xFF, 0xFF };   // history of digits
-  /* ------------------------------------------------------------- */
-  static bool     send_pending = false;      // need to send digit ?
-  static uint8_t  digit_key    = 0;          // HID key to emit
-  static bool     pressed      = false;      // phase-tracker for HID send
-  /* ------------------------------------------------------------- */
-
-  // one-time initialisation
-  if (!init)
-  {
-    debounced_state = gpio_get(PULSE_PIN);   // should be HIGH
-    instant_state   = debounced_state;
-    debounce_start  = board_millis();
-    last_pulse_time = board_millis();
-    init = true;
-  }
-
-  // Abort dialling when handset is hung up (HANGUP_PIN is HIGH)
-  if (gpio_get(HANGUP_PIN))
-  {
-    pulse_count  = 0;
-    send_pending = false;
-    pressed      = false;
-    return;                    // nothing else while on-hook
-  }
-
-  /* --------- sample pin & drive onboard LED ------------------- */
-  bool sample = gpio_get(PULSE_PIN);
-
-  /* --------- debounce identical to original C example --------- */
-  if (sample != instant_state)
-  {
-    instant_state  = sample;
-    debounce_start = board_millis();
-  }
-
-  if ((uint32_t)(board_millis() - debounce_start) >= PULSE_DEBOUNCE_MS)
-  {
-    if (instant_state != debounced_state)          // stable change
-    {
-      debounced_state = instant_state;
-      last_pulse_time = board_millis();
-
-      if (!debounced_state) ++pulse_count;         // LOW edge counted
-    }
-  }
-
-  /* --------- detect end-of-digit ( >400 ms silence ) ---------- */
-  uint32_t now_ms = board_millis();
-  if (!send_pending && pulse_count &&
-      (now_ms - last_pulse_time) > 400)
-  {
-    uint32_t cnt = pulse_count;
-    pulse_count  = 0;
-
-    /* ---- update rolling buffer with the new digit --------------- */
-    uint8_t new_digit = (cnt == 10) ? 0 : (cnt <= 9 ? cnt : 0xFF);
-    last4[0] = last4[1];
-    last4[1] = last4[2];
-    last4[2] = last4[3];
-    last4[3] = new_digit;
-
-    if (last4[0] == 1 && last4[1] == 2 && last4[2] == 3 && last4[3] == 4)
-    {
-      reset_usb_boot(1 << digitalPinToPinName(LED_BUILTIN), 0);
-    }
-    /* ------------------------------------------------------------- */
-
-    if      (cnt == 10) digit_key = HID_KEY_0;
-    else if (cnt <= 9)  digit_key = HID_KEY_1 + (cnt - 1);
-    else                digit_key = 0;
-
-    if (digit_key) send_pending = true;
-  }
-
-  /* --------- 2-phase HID send (press / release) --------------- */
-  if (send_pending && tud_hid_ready())
-  {
-    if (!pressed)                         // phase 1 : press
+    if (!boot_mount_us)
     {
-      uint8_t kc[6] = { digit_key, 0,0,0,0,0 };
-      tud_hid_keyboard_report(REPORT_ID_KEYBOARD, 0, kc);
-      pressed = true;
+        boot_mount_us = time_us_32();   // enumeration is done once configured
     }
-    else                                  // phase 2 : release
-    {
-      tud_hid_keyboard_report(REPORT_ID_KEYBOARD, 0, NULL);
-      pressed      = false;
-      send_pending = false;
-    }
-  }
+    power_set_suspended(false);
+    hid_queue_report_complete();
 }
 
-void hangup_task(void)
+void tud_umount_cb(void)
 {
-  // ------------- multi-key sequence control --------------------
-  enum HangState {
-    HS_IDLE,
-    HS_PRESS_ALTQ,  HS_RELEASE_ALTQ,  HS_WAIT1,
-    HS_PRESS_ENTER, HS_RELEASE_ENTER, HS_WAIT2,
-    HS_PRESS_CTRLW, HS_RELEASE_CTRLW, HS_WAIT3,
-    HS_PRESS_CSH,   HS_RELEASE_CSH
-  };
-  static HangState state   = HS_IDLE;
-  static uint32_t  last_ms = 0;           // used for both 1-s rate-limit and 20-ms waits
-
-  // --- 50-ms debouncer -------------------------------------------------
-  static bool     debounced_state  = gpio_get(HANGUP_PIN);
-  static bool     instant_state    = debounced_state;
-  static uint32_t debounce_start   = board_millis();
-  // --------------------------------------------------------------------
-
-  // ----------- sample & debounce ( ≥50 ms stable ) --------------------
-  bool     sample   = gpio_get(HANGUP_PIN);
-  uint32_t now_ms   = board_millis();
-
-  if (sample != instant_state)
-  {                               // level changed → restart timer
-    instant_state  = sample;
-    debounce_start = now_ms;
-  }
-
-  if ((uint32_t)(now_ms - debounce_start) >= 50)     // 50-ms stable ?
-  {
-    if (instant_state != debounced_state)            // accept new state
-    {
-      debounced_state = instant_state;
-
-      // rising edge (LOW → HIGH) initiates sequence, but not more than once/sec
-      if (debounced_state &&
-          state == HS_IDLE &&
-          (uint32_t)(now_ms - last_ms) >= 1000)
-      {
-        state   = HS_PRESS_ALTQ;   // start the 3-key sequence
-        // last_ms keeps its old value for the 1-s limit; it will be
-        // updated when the sequence is finished
-      }
-    }
-  }
+    hid_queue_report_complete();
+}
 
-  // ---------------- send Alt-Q, Enter, Ctrl-W sequence -----------------
-  if (tud_hid_ready())
-  {
-    switch (state)
-    {
-      case HS_PRESS_ALTQ:
-      {
-        uint8_t kc[6] = { HID_KEY_Q, 0,0,0,0,0 };
-        tud_hid_keyboard_report(REPORT_ID_KEYBOARD,
-                                KEYBOARD_MODIFIER_LEFTALT, kc);
-        state = HS_RELEASE_ALTQ;
-        break;
-      }
-
-      case HS_RELEASE_ALTQ:
-        tud_hid_keyboard_report(REPORT_ID_KEYBOARD, 0, NULL);
-        last_ms = board_millis();
-        state   = HS_WAIT1;
-        break;
-
-      case HS_WAIT1:
-        if (board_millis() - last_ms >= 20) state = HS_PRESS_ENTER;
-        break;
-
-      case HS_PRESS_ENTER:
-      {
-        uint8_t kc[6] = { HID_KEY_ENTER, 0,0,0,0,0 };
-        tud_hid_keyboard_report(REPORT_ID_KEYBOARD, 0, kc);
-        state = HS_RELEASE_ENTER;
-        break;
-      }
-
-      case HS_RELEASE_ENTER:
-        tud_hid_keyboard_report(REPORT_ID_KEYBOARD, 0, NULL);
-        last_ms = board_millis();
-        state   = HS_WAIT2;
-        break;
-
-      case HS_WAIT2:
-        if (board_millis() - last_ms >= 20) state = HS_PRESS_CTRLW;
-        break;
-
-      case HS_PRESS_CTRLW:
-      {
-        uint8_t kc[6] = { HID_KEY_W, 0,0,0,0,0 };
-        tud_hid_keyboard_report(REPORT_ID_KEYBOARD,
-                                KEYBOARD_MODIFIER_LEFTCTRL, kc);
-        state = HS_RELEASE_CTRLW;
-        break;
-      }
-
-      case HS_RELEASE_CTRLW:
-        tud_hid_keyboard_report(REPORT_ID_KEYBOARD, 0, NULL);
-        last_ms = board_millis();     // start 20-ms pause before C-S-H
-        state   = HS_WAIT3;
-        break;
-
-      case HS_WAIT3:                         // 20-ms pause after Ctrl-W
-        if (board_millis() - last_ms >= 20) state = HS_PRESS_CSH;
-        break;
-
-      case HS_PRESS_CSH:                     // Ctrl-Shift-H  (press)
-      {
-        uint8_t kc[6] = { HID_KEY_H, 0,0,0,0,0 };
-        tud_hid_keyboard_report(REPORT_ID_KEYBOARD,
-                                KEYBOARD_MODIFIER_LEFTCTRL |
-                                KEYBOARD_MODIFIER_LEFTSHIFT, kc);
-        state = HS_RELEASE_CSH;
-        break;
-      }
-
-      case HS_RELEASE_CSH:                   // Ctrl-Shift-H  (release)
-        tud_hid_keyboard_report(REPORT_ID_KEYBOARD, 0, NULL);
-        last_ms = board_millis();            // restart 1-s rate-limit timer
-        state   = HS_IDLE;
-        break;
-
-      default:
-        break;
-    }
-  }
-  // --------------------------------------------------------------------
+// the host must see less than 2.5 mA from here on
+void tud_suspend_cb(bool remote_wakeup_en)
+{
+    (void)remote_wakeup_en;
+    power_set_suspended(true);
 }
 
+void tud_resume_cb(void)
+{
+    power_set_suspended(false);
+}
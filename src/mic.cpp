@@ -0,0 +1,209 @@
+/**
+ * @file mic.cpp
+ * @brief ADC + DMA microphone capture, see mic.h
+ */
+
+#include "mic.h"
+#include "dsp.h"
+#include "stats.h"
+#include "hardware/adc.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "pico/time.h"
+
+#define ADC_CLOCK_HZ  48000000  // clk_adc, from PLL_USB like the USB clock
+
+#define RING_BYTES    (MIC_RING_SAMPLES * sizeof(uint16_t))
+#define RING_BITS     __builtin_ctz(RING_BYTES)
+// samples per channel run; a whole number of laps, so each run ends back
+// at the start of the ring, and 21 s long
+#define RUN_SAMPLES   (1u << 20)
+// unsent samples the DMA may run ahead by: a packet is read out of the
+// rest while the DMA goes on writing
+#define FILL_MAX      (MIC_RING_SAMPLES - 2 * AUDIO_SAMPLES_PER_FRAME)
+
+static_assert((MIC_RING_SAMPLES & (MIC_RING_SAMPLES - 1)) == 0 && RUN_SAMPLES % MIC_RING_SAMPLES == 0,
+              "the DMA wraps its write address on a power of two");
+static_assert(FILL_MAX >= 2 * MIC_FILL_SAMPLES, "ring too small for the fill target");
+
+// DMA writes raw 12-bit samples. They stay raw, mic_frame() converts a
+// packet's worth into pcm and mic_latest() reads right behind the DMA.
+// The write address wraps within the ring in hardware, so however late
+// the interrupt runs, the DMA never leaves it.
+static uint16_t ring[MIC_RING_SAMPLES] __attribute__((aligned(RING_BYTES)));
+static int16_t  pcm[AUDIO_SAMPLES_PER_FRAME + 1];
+
+static int dma_chan[2];                 // [0] runs first, then they take turns
+static volatile uint32_t runs_done = 0;
+static volatile bool     running   = false;
+static uint32_t          read_pos  = 0;  // samples sent since mic_start()
+static uint32_t          fill_avg  = 0;  // unsent samples, 1/16 average, Q4
+
+static inline int16_t to_pcm(uint16_t raw)
+{
+    return (int16_t)((raw - 2048) * 16);    // 12 bits -> full scale
+}
+
+static void mic_dma_irq(void)
+{
+    for (int i = 0; i < 2; i++)
+    {
+        if (!dma_channel_get_irq0_status(dma_chan[i]))
+        {
+            continue;
+        }
+        dma_channel_acknowledge_irq0(dma_chan[i]);
+
+        // the other channel has taken over; this one is back at the start
+        // of the ring with its count reloaded, nothing to re-arm
+        runs_done = runs_done + 1;
+    }
+}
+
+static void configure_channel(int i, bool chained)
+{
+    dma_channel_config c = dma_channel_get_default_config(dma_chan[i]);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_ring(&c, true, RING_BITS);
+    channel_config_set_dreq(&c, DREQ_ADC);
+    // chaining to itself is how the SDK spells "no chain"
+    channel_config_set_chain_to(&c, dma_chan[chained ? 1 - i : i]);
+
+    dma_channel_configure(dma_chan[i], &c, ring, &adc_hw->fifo, RUN_SAMPLES, false);
+}
+
+void mic_init(void)
+{
+    adc_init();
+    adc_gpio_init(MIC_PIN);
+    adc_select_input(MIC_ADC_INPUT);
+    adc_set_clkdiv(ADC_CLOCK_HZ / AUDIO_SAMPLE_RATE - 1);
+    adc_fifo_setup(true, true, 1, false, false);    // DREQ per sample, 12 bits
+
+    dma_chan[0] = dma_claim_unused_channel(true);
+    dma_chan[1] = dma_claim_unused_channel(true);
+    irq_add_shared_handler(DMA_IRQ_0, mic_dma_irq, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_0, true);
+}
+
+void mic_start(void)
+{
+    if (running)
+    {
+        return;
+    }
+
+    adc_run(false);
+    adc_fifo_drain();
+
+    runs_done = 0;
+    read_pos  = 0;
+    fill_avg  = MIC_FILL_SAMPLES << 4;
+    configure_channel(0, true);
+    configure_channel(1, true);
+    dma_channel_set_irq0_enabled(dma_chan[0], true);
+    dma_channel_set_irq0_enabled(dma_chan[1], true);
+
+    dma_channel_start(dma_chan[0]);
+    adc_run(true);
+    running = true;
+}
+
+void mic_stop(void)
+{
+    if (!running)
+    {
+        return;
+    }
+
+    adc_run(false);
+    dma_channel_set_irq0_enabled(dma_chan[0], false);
+    dma_channel_set_irq0_enabled(dma_chan[1], false);
+    // unchain first, aborting a chained channel can start the other one
+    configure_channel(0, false);
+    configure_channel(1, false);
+    dma_channel_abort(dma_chan[0]);
+    dma_channel_abort(dma_chan[1]);
+    adc_fifo_drain();
+    running = false;
+}
+
+// Samples the DMA has written since mic_start(); the one it writes next is
+// this modulo the ring. Call from the DMA interrupt or with it held off.
+static uint32_t write_pos(void)
+{
+    uint32_t done = runs_done;
+    uint32_t left = dma_channel_hw_addr(dma_chan[done & 1])->transfer_count;
+
+    if (left == 0 && !dma_channel_is_busy(dma_chan[done & 1]))
+    {
+        // finished and chained on, its interrupt just hasn't run yet
+        done++;
+        left = dma_channel_hw_addr(dma_chan[done & 1])->transfer_count;
+    }
+    return done * RUN_SAMPLES + RUN_SAMPLES - left;
+}
+
+const int16_t *mic_frame(size_t *samples, uint64_t *captured_us)
+{
+    if (!running)
+    {
+        return NULL;
+    }
+
+    uint32_t irq  = save_and_disable_interrupts();
+    uint32_t head = write_pos();
+    restore_interrupts(irq);
+
+    // the host fell behind so far that the DMA may have lapped read_pos:
+    // start again at the target fill so latency stays put
+    uint32_t fill = head - read_pos;
+    if (fill > FILL_MAX)
+    {
+        stats_count(COUNTER_MIC_OVERRUNS);
+        read_pos = head - MIC_FILL_SAMPLES;
+        fill     = MIC_FILL_SAMPLES;
+        fill_avg = MIC_FILL_SAMPLES << 4;
+    }
+
+    // one sample more or less when the ADC clock has drifted against the
+    // host's frames, rather than a whole frame skipped or filled with silence
+    fill_avg += (int32_t)((fill << 4) - fill_avg) / 16;
+    size_t n = AUDIO_SAMPLES_PER_FRAME;
+    if      (fill_avg > (MIC_FILL_SAMPLES + MIC_FILL_SLACK) << 4) n++;
+    else if (fill_avg < (MIC_FILL_SAMPLES - MIC_FILL_SLACK) << 4) n--;
+    if (fill < n)
+    {
+        stats_count(COUNTER_MIC_UNDERRUNS);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < n; i++, read_pos++)
+    {
+        pcm[i] = to_pcm(ring[read_pos % MIC_RING_SAMPLES]);
+    }
+    dsp_process(pcm, n);
+
+    *samples     = n;
+    *captured_us = time_us_64() - fill * 1000000ull / AUDIO_SAMPLE_RATE;
+    return pcm;
+}
+
+size_t mic_latest(int16_t *out, size_t samples)
+{
+    if (!running)
+    {
+        return 0;
+    }
+
+    // walk back from the sample being written
+    uint32_t pos = write_pos();
+    for (size_t i = samples; i > 0; i--)
+    {
+        out[i - 1] = to_pcm(ring[--pos % MIC_RING_SAMPLES]);
+    }
+    return samples;
+}
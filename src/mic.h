@@ -0,0 +1,47 @@
+/**
+ * @file mic.h
+ * @brief handset microphone capture: ADC -> DMA ring
+ *
+ * The ADC free-runs at AUDIO_SAMPLE_RATE and two chained DMA channels
+ * take turns filling a ring of MIC_RING_SAMPLES, wrapping their write
+ * address in hardware, so no CPU time is spent per sample and a late
+ * interrupt can't send the DMA anywhere else. The endpoint is asynchronous: the USB side reads
+ * a packet per frame from about MIC_FILL_SAMPLES behind the DMA, and
+ * sends one sample more or less than a frame's worth whenever the ADC
+ * clock has drifted against the host's frames. A host that falls far
+ * behind is caught up in one jump, so the delay never grows.
+ */
+
+#ifndef MIC_H
+#define MIC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tusb.h"   // AUDIO_SAMPLE_RATE, AUDIO_SAMPLES_PER_FRAME
+
+#define MIC_PIN         26      // ADC0, handset capsule biased to mid-rail
+#define MIC_ADC_INPUT   (MIC_PIN - 26)
+#define MIC_RING_SAMPLES 512    // 10.7 ms, a power of two
+#define MIC_FILL_SAMPLES 96     // unsent samples to keep, covers host polling jitter
+#define MIC_FILL_SLACK  24      // how far the average may stray before a 47 or 49
+
+// Once at start-up, on the core that runs TinyUSB
+void mic_init(void);
+
+// Run the ADC and DMA while the host has the stream open
+void mic_start(void);
+void mic_stop(void);
+
+// The next packet as signed 16-bit PCM, run through the dsp.h chain:
+// AUDIO_SAMPLES_PER_FRAME samples, or one more or less to follow the ADC
+// clock. NULL if too few samples have come in. captured_us is when its
+// first sample was taken.
+const int16_t *mic_frame(size_t *samples, uint64_t *captured_us);
+
+// The last samples the ADC took, oldest first, as plain PCM for the
+// sidetone; 0 while the mic is stopped. Call from the DMA interrupt or
+// with it held off, samples must be well under MIC_RING_SAMPLES.
+size_t mic_latest(int16_t *out, size_t samples);
+
+#endif /* MIC_H */
@@ -0,0 +1,47 @@
+/**
+ * @file phone.cpp
+ * @brief HID Telephony state, see phone.h
+ */
+
+#include "phone.h"
+#include "hid_queue.h"
+#include "stats.h"
+#include "usb_descriptors.h"
+
+static uint8_t buttons[DIAL_LINES];     // last input report queued
+static uint8_t host_leds[DIAL_LINES];
+
+bool phone_hook(uint8_t line, bool off_hook)
+{
+    uint8_t now  = buttons[line];
+    uint8_t next = off_hook ? (now | PHONE_HOOK_SWITCH) : (now & ~PHONE_HOOK_SWITCH);
+
+    if (!hid_queue_phone(line, next))
+    {
+        return false;
+    }
+    buttons[line] = next;
+    return true;
+}
+
+bool phone_mute_press(uint8_t line)
+{
+    if (hid_queue_free() < 2)
+    {
+        stats_count(COUNTER_HID_DROPS);
+        return false;
+    }
+    // with room for both checked, the release can't be refused after the press
+    return hid_queue_phone(line, buttons[line] | PHONE_MUTE) &&
+           hid_queue_phone(line, buttons[line]);
+}
+
+void phone_set_leds(uint8_t line, uint8_t leds)
+{
+    host_leds[line] = leds;
+}
+
+uint8_t phone_leds(uint8_t line)
+{
+    return host_leds[line];
+}
@@ -0,0 +1,39 @@
+/**
+ * @file phone.h
+ * @brief HID Telephony: hook switch and mute up, call state LEDs down
+ *
+ * The handset shows up as a telephony headset next to the keyboard, so
+ * call apps see the hook switch as such instead of guessing from keyboard
+ * shortcuts. Input reports go through the HID queue like everything else;
+ * the output report from the host lands in phone_set_leds().
+ */
+
+#ifndef PHONE_H
+#define PHONE_H
+
+#include <stdint.h>
+
+// Input report bits (REPORT_ID_TELEPHONY)
+#define PHONE_HOOK_SWITCH   0x01    // 1 while off-hook
+#define PHONE_MUTE          0x02    // pressed; the host toggles on each press
+
+// Output report bits, LED usage page
+#define PHONE_LED_OFF_HOOK  0x01    // a call is active
+#define PHONE_LED_RING      0x02    // a call is coming in
+#define PHONE_LED_MUTE      0x04
+#define PHONE_LED_HOLD      0x08
+
+// Every line (usb_descriptors.h) is a headset of its own, with its own
+// report IDs and call state.
+
+// Queue a report with the new hook switch state; false if the queue is full
+bool phone_hook(uint8_t line, bool off_hook);
+
+// Queue a press and release of Phone Mute
+bool phone_mute_press(uint8_t line);
+
+// Call state from the host's output report, and the last one received
+void    phone_set_leds(uint8_t line, uint8_t leds);
+uint8_t phone_leds(uint8_t line);
+
+#endif /* PHONE_H */
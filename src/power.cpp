@@ -0,0 +1,131 @@
+/**
+ * @file power.cpp
+ * @brief WFE idle and deep sleep during USB suspend, see power.h
+ *
+ * Dormant mode is not used: it stops the crystal, and the USB controller
+ * needs clk_usb running to see resume signalling and bus reset. Deep sleep
+ * with a trimmed sleep_en mask keeps just that alive. The mask only takes
+ * effect once both cores sleep deeply, so each core sets its own SLEEPDEEP
+ * and the mask itself follows the suspend state.
+ */
+
+#include "power.h"
+#include "hardware/clocks.h"
+#include "hardware/gpio.h"
+#include "hardware/structs/scb.h"
+#include "hardware/timer.h"
+#include "pico/platform.h"
+#include "pico/time.h"
+
+// Clocks that keep running in deep sleep: USB (resume, reset), the timer
+// and its tick (wake-up alarm), IO and pads (edge interrupts), PIO0 (the
+// dial edge timers) and whatever feeds them.
+#define SLEEP_EN0_SUSPENDED (CLOCKS_SLEEP_EN0_CLK_SYS_PLL_USB_BITS |             \
+                             CLOCKS_SLEEP_EN0_CLK_SYS_PLL_SYS_BITS |             \
+                             CLOCKS_SLEEP_EN0_CLK_SYS_CLOCKS_BITS |              \
+                             CLOCKS_SLEEP_EN0_CLK_SYS_BUSFABRIC_BITS |           \
+                             CLOCKS_SLEEP_EN0_CLK_SYS_IO_BITS |                  \
+                             CLOCKS_SLEEP_EN0_CLK_SYS_PADS_BITS |                \
+                             CLOCKS_SLEEP_EN0_CLK_SYS_PIO0_BITS |                \
+                             CLOCKS_SLEEP_EN0_CLK_SYS_VREG_AND_CHIP_RESET_BITS)
+#define SLEEP_EN1_SUSPENDED (CLOCKS_SLEEP_EN1_CLK_SYS_XOSC_BITS |                \
+                             CLOCKS_SLEEP_EN1_CLK_SYS_WATCHDOG_BITS |            \
+                             CLOCKS_SLEEP_EN1_CLK_SYS_TIMER_BITS |               \
+                             CLOCKS_SLEEP_EN1_CLK_SYS_USBCTRL_BITS |             \
+                             CLOCKS_SLEEP_EN1_CLK_USB_USBCTRL_BITS)
+
+static volatile bool suspended = false;    // written from the USB callbacks
+
+// per core, each only ever written by its own core
+static uint64_t awake_total_us[2]  = { 0, 0 };
+static uint64_t asleep_total_us[2] = { 0, 0 };
+static uint64_t woke_us[2]         = { 0, 0 };
+static uint     wake_alarm[2];      // a hardware alarm per core, its IRQ on that core
+
+// Taking the interrupt is what ends the WFE, nothing to do in it
+static void on_wake_alarm(uint alarm)
+{
+    (void)alarm;
+}
+
+void power_init(void)
+{
+    uint core = get_core_num();
+
+#ifdef DUTY_CYCLE_PIN
+    gpio_init(DUTY_CYCLE_PIN + core);
+    gpio_set_dir(DUTY_CYCLE_PIN + core, GPIO_OUT);
+    gpio_put(DUTY_CYCLE_PIN + core, 1);
+#endif
+    wake_alarm[core] = (uint)hardware_alarm_claim_unused(true);
+    hardware_alarm_set_callback(wake_alarm[core], on_wake_alarm);
+    woke_us[core] = time_us_64();
+}
+
+void power_set_suspended(bool s)
+{
+    suspended = s;
+    clocks_hw->sleep_en0 = s ? SLEEP_EN0_SUSPENDED : ~0u;
+    clocks_hw->sleep_en1 = s ? SLEEP_EN1_SUSPENDED : ~0u;
+}
+
+void power_sleep_until(uint64_t deadline_us)
+{
+    uint     core     = get_core_num();
+    uint64_t sleep_us = time_us_64();
+
+    if (deadline_us <= sleep_us)
+    {
+        return;
+    }
+    awake_total_us[core] += sleep_us - woke_us[core];
+
+#ifdef DUTY_CYCLE_PIN
+    gpio_put(DUTY_CYCLE_PIN + core, 0);
+#endif
+
+    // Any interrupt taken since the tasks ran, or a __sev() from the other
+    // core, has set the event register, so the WFE below falls straight
+    // through instead of missing it. That is why this is exactly one WFE
+    // on our own alarm: best_effort_wfe_or_timeout() may run a __sev()
+    // __wfe() pair of its own first, which would eat such an event.
+    bool deep = suspended;
+    if (deep)
+    {
+        scb_hw->scr |= M0PLUS_SCR_SLEEPDEEP_BITS;
+    }
+
+    if (deadline_us == UINT64_MAX)
+    {
+        __wfe();
+    }
+    else if (!hardware_alarm_set_target(wake_alarm[core], from_us_since_boot(deadline_us)))
+    {
+        __wfe();
+        hardware_alarm_cancel(wake_alarm[core]);
+    }
+
+    if (deep)
+    {
+        scb_hw->scr &= ~M0PLUS_SCR_SLEEPDEEP_BITS;
+    }
+
+#ifdef DUTY_CYCLE_PIN
+    gpio_put(DUTY_CYCLE_PIN + core, 1);
+#endif
+
+    woke_us[core] = time_us_64();
+    asleep_total_us[core] += woke_us[core] - sleep_us;
+}
+
+void power_stats(uint8_t core, uint64_t *awake_us, uint64_t *asleep_us)
+{
+    // the other core's totals are read without a lock and may be one
+    // sleep behind, good enough for a duty cycle
+    *awake_us  = awake_total_us[core];
+    *asleep_us = asleep_total_us[core];
+    if (core == get_core_num())
+    {
+        *awake_us += time_us_64() - woke_us[core];
+    }
+}
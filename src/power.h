@@ -0,0 +1,37 @@
+/**
+ * @file power.h
+ * @brief idle sleep for the main loop and USB-suspend power saving
+ *
+ * Every task reports when it next has timed work to do; everything else
+ * (pin edges, USB traffic, events from the other core) arrives by interrupt
+ * or __sev(). Each core's loop therefore runs its tasks once and then
+ * sleeps in WFE until the earliest deadline or the next event, whichever
+ * comes first.
+ */
+
+#ifndef POWER_H
+#define POWER_H
+
+#include <stdint.h>
+
+// Scope output: DUTY_CYCLE_PIN is high while core 0 is awake, the pin
+// after it while core 1 is. Leave undefined to keep the pins free.
+// #define DUTY_CYCLE_PIN  20
+
+// Call once on each core before its loop starts
+void power_init(void);
+
+// Sleep until deadline_us (hal_time_us() clock, UINT64_MAX for "no
+// deadline") or until any interrupt. Returns straight away if an interrupt
+// or __sev() came in since the previous sleep; such an event is only lost
+// if something else clears the event register between the tasks and here.
+void power_sleep_until(uint64_t deadline_us);
+
+// Called from the TinyUSB suspend/resume callbacks. While suspended the
+// sleep is a deep sleep that gates every clock but USB, timer and GPIO.
+void power_set_suspended(bool suspended);
+
+// Total time core spent awake and asleep since power_init(), for duty cycle
+void power_stats(uint8_t core, uint64_t *awake_us, uint64_t *asleep_us);
+
+#endif /* POWER_H */
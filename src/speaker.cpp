@@ -0,0 +1,323 @@
+/**
+ * @file speaker.cpp
+ * @brief PWM + DMA earpiece playback, see speaker.h
+ */
+
+#include <math.h>
+
+#include "tusb.h"   // AUDIO_SAMPLE_RATE, AUDIO_SAMPLES_PER_FRAME
+
+#include "speaker.h"
+#include "config.h"
+#include "mic.h"
+#include "spsc_ring.h"
+#include "stats.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/pwm.h"
+#include "pico/time.h"
+
+#define PWM_BITS    10                      // 122 kHz carrier at 125 MHz
+#define PWM_TOP     ((1u << PWM_BITS) - 1)
+#define PWM_MID     (1u << (PWM_BITS - 1))  // silence
+
+// Filled by speaker_write() from the USB task, drained by the DMA IRQ
+static SpscRing<int16_t, 512> jitter;
+static_assert(SPEAKER_DEPTH_MAX_MS * AUDIO_SAMPLES_PER_FRAME + 2 * AUDIO_SAMPLES_PER_FRAME <= 512,
+              "jitter buffer too small for the maximum depth");
+
+// A third of a frame, so the sidetone in a block is never more than
+// two blocks (0.67 ms) old when it plays
+#define BLOCK_SAMPLES (AUDIO_SAMPLES_PER_FRAME / 3)
+#define BLOCK_BYTES   (BLOCK_SAMPLES * sizeof(uint16_t))
+#define BLOCKS_PER_S  (AUDIO_SAMPLE_RATE / BLOCK_SAMPLES)
+
+static_assert((BLOCK_BYTES & (BLOCK_BYTES - 1)) == 0 && AUDIO_SAMPLE_RATE % BLOCK_SAMPLES == 0,
+              "the DMA wraps its read address on a power of two");
+
+// Compare levels, DMA reads them straight into the PWM slice. 16-bit
+// writes to APB registers are replicated into both halves, so channel
+// B of the slice follows A, which is harmless with its pin unused.
+// Each channel's read address wraps within its own block in hardware, so
+// however late the interrupt runs, a block just plays again.
+static uint16_t blocks[2][BLOCK_SAMPLES] __attribute__((aligned(BLOCK_BYTES)));
+
+static int      dma_chan[2];
+static uint     slice;
+static volatile bool running = false;
+static volatile uint32_t blocks_played = 0; // channel 0 plays the even ones
+static uint64_t irq_us       = 0;       // when the DMA interrupt last ran
+static bool     primed       = false;   // depth reached since the last underrun
+static uint32_t depth        = SPEAKER_DEPTH_MS * AUDIO_SAMPLES_PER_FRAME;
+static volatile int32_t gain_q15 = 32767;
+static bool     muted        = false;
+static int32_t  volume_q15   = 32767;
+static volatile int32_t sidetone_q15 = 0;   // 0 while on-hook
+static int32_t  sidetone_level_q15   = 0;
+static int16_t  sidetone_db  = SIDETONE_DEFAULT;
+static bool     off_hook     = false;
+
+static int32_t db_to_q15(int16_t db_256)
+{
+    return (int32_t)(32767.0f * powf(10.0f, db_256 / (256.0f * 20.0f)));
+}
+
+static void fill_block(uint16_t *block)
+{
+    int32_t mix[BLOCK_SAMPLES] = { 0 };
+
+    if (!primed && jitter.size() >= depth)
+    {
+        primed = true;
+    }
+
+    int32_t  gain = gain_q15;
+    uint32_t i    = 0;
+    int16_t  sample;
+    while (primed && i < BLOCK_SAMPLES && jitter.pop(sample))
+    {
+        mix[i++] = (sample * gain) >> 15;
+    }
+    if (primed && i < BLOCK_SAMPLES)
+    {
+        stats_count(COUNTER_SPK_UNDERRUNS);
+        primed = false;                      // wait for the depth again
+    }
+
+    // sidetone, sample by sample, straight from behind the ADC's DMA
+    int32_t side = sidetone_q15;
+    int16_t voice[BLOCK_SAMPLES];
+    if (side && mic_latest(voice, BLOCK_SAMPLES) == BLOCK_SAMPLES)
+    {
+        for (i = 0; i < BLOCK_SAMPLES; i++)
+        {
+            mix[i] += (voice[i] * side) >> 15;
+        }
+    }
+
+    for (i = 0; i < BLOCK_SAMPLES; i++)
+    {
+        int32_t v = mix[i] < INT16_MIN ? INT16_MIN : mix[i] > INT16_MAX ? INT16_MAX : mix[i];
+        block[i] = (uint16_t)((v + 32768) >> (16 - PWM_BITS));
+    }
+}
+
+// Blocks finished by now: the count nearest to the clock's estimate that
+// leaves the playing channel's parity. Normally one more than before, but
+// with interrupts held off (a flash write) several blocks may have gone.
+static uint32_t blocks_finished(int playing, uint64_t now_us)
+{
+    uint32_t before = blocks_played;
+    uint64_t target = before * 1000000ull + (now_us - irq_us) * BLOCKS_PER_S;   // in 1e-6 blocks
+    uint32_t played = (uint32_t)((target + 1000000ull - playing * 1000000ull) / 2000000ull) * 2 + playing;
+
+    if ((int32_t)(played - before) < 1)
+    {
+        played = before + ((before & 1) != (uint32_t)playing ? 1 : 2);
+    }
+    return played;
+}
+
+static void speaker_dma_irq(void)
+{
+    bool done = false;
+    for (int i = 0; i < 2; i++)
+    {
+        if (dma_channel_get_irq0_status(dma_chan[i]))
+        {
+            dma_channel_acknowledge_irq0(dma_chan[i]);
+            done = true;
+        }
+    }
+    if (!done)
+    {
+        return;
+    }
+
+    // the other channel plays its block now and comes back to this one by
+    // itself; only refill it
+    int      playing = dma_channel_is_busy(dma_chan[1]) ? 1 : 0;
+    uint64_t now_us  = time_us_64();
+    blocks_played = blocks_finished(playing, now_us);
+    irq_us        = now_us;
+    fill_block(blocks[1 - playing]);
+}
+
+static void configure_channel(int i, bool chained, uint dreq)
+{
+    dma_channel_config c = dma_channel_get_default_config(dma_chan[i]);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_ring(&c, false, __builtin_ctz(BLOCK_BYTES));
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, dreq);
+    channel_config_set_chain_to(&c, dma_chan[chained ? 1 - i : i]);
+
+    dma_channel_configure(dma_chan[i], &c, &pwm_hw->slice[slice].cc, blocks[i],
+                          BLOCK_SAMPLES, false);
+}
+
+static uint32_t gcd(uint32_t a, uint32_t b)
+{
+    while (b)
+    {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static uint pacing_dreq;
+
+void speaker_init(void)
+{
+    gpio_set_function(EARPIECE_PIN, GPIO_FUNC_PWM);
+    slice = pwm_gpio_to_slice_num(EARPIECE_PIN);
+
+    pwm_config pc = pwm_get_default_config();
+    pwm_config_set_wrap(&pc, PWM_TOP);
+    pwm_init(slice, &pc, true);
+    pwm_set_gpio_level(EARPIECE_PIN, PWM_MID);
+    speaker_set_sidetone(SIDETONE_DEFAULT);
+    depth = config.speaker_depth_ms * AUDIO_SAMPLES_PER_FRAME;    // range checked by config.cpp
+
+    // one transfer per sample: clk_sys * num / den == AUDIO_SAMPLE_RATE
+    uint32_t sys   = clock_get_hz(clk_sys);
+    uint32_t g     = gcd(sys, AUDIO_SAMPLE_RATE);
+    int      timer = dma_claim_unused_timer(true);
+    hard_assert(sys / g <= 0xFFFF);
+    dma_timer_set_fraction(timer, AUDIO_SAMPLE_RATE / g, sys / g);
+    pacing_dreq = dma_get_timer_dreq(timer);
+
+    dma_chan[0] = dma_claim_unused_channel(true);
+    dma_chan[1] = dma_claim_unused_channel(true);
+    irq_add_shared_handler(DMA_IRQ_0, speaker_dma_irq, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_0, true);
+}
+
+void speaker_start(void)
+{
+    if (running)
+    {
+        return;
+    }
+
+    primed        = false;
+    blocks_played = 0;
+    fill_block(blocks[0]);
+    fill_block(blocks[1]);
+    configure_channel(0, true, pacing_dreq);
+    configure_channel(1, true, pacing_dreq);
+    dma_channel_set_irq0_enabled(dma_chan[0], true);
+    dma_channel_set_irq0_enabled(dma_chan[1], true);
+    irq_us = time_us_64();
+    dma_channel_start(dma_chan[0]);
+    running = true;
+}
+
+void speaker_stop(void)
+{
+    if (!running)
+    {
+        return;
+    }
+
+    dma_channel_set_irq0_enabled(dma_chan[0], false);
+    dma_channel_set_irq0_enabled(dma_chan[1], false);
+    // unchain first, aborting a chained channel can start the other one
+    configure_channel(0, false, pacing_dreq);
+    configure_channel(1, false, pacing_dreq);
+    dma_channel_abort(dma_chan[0]);
+    dma_channel_abort(dma_chan[1]);
+    pwm_set_gpio_level(EARPIECE_PIN, PWM_MID);
+    running = false;
+
+    int16_t sample;
+    while (jitter.pop(sample))
+    {
+    }
+}
+
+void speaker_write(const int16_t *pcm, size_t samples)
+{
+    if (!running)
+    {
+        return;
+    }
+
+    // never let the buffer grow past two packets over the depth
+    uint32_t room = depth + 2 * AUDIO_SAMPLES_PER_FRAME;
+    uint32_t fill = jitter.size();
+    size_t   n    = fill >= room ? 0 : room - fill;
+    if (n < samples)
+    {
+        stats_count(COUNTER_SPK_OVERRUNS);
+        samples = n;
+    }
+    for (size_t i = 0; i < samples; i++)
+    {
+        jitter.push(pcm[i]);
+    }
+}
+
+uint32_t speaker_samples_played(void)
+{
+    uint32_t blocks = blocks_played;
+    int      cur    = blocks & 1;
+    uint32_t left   = dma_channel_hw_addr(dma_chan[cur])->transfer_count;
+
+    if (left == 0 && !dma_channel_is_busy(dma_chan[cur]))
+    {
+        // finished and chained on, its interrupt just hasn't run yet
+        blocks++;
+        left = dma_channel_hw_addr(dma_chan[1 - cur])->transfer_count;
+    }
+    return blocks * BLOCK_SAMPLES + BLOCK_SAMPLES - left;
+}
+
+uint32_t speaker_fill(void)
+{
+    return jitter.size();
+}
+
+uint8_t speaker_depth_ms(void)
+{
+    return depth / AUDIO_SAMPLES_PER_FRAME;
+}
+
+void speaker_set_volume(int16_t db_256)
+{
+    if (db_256 < SPEAKER_VOLUME_MIN) db_256 = SPEAKER_VOLUME_MIN;
+    if (db_256 > SPEAKER_VOLUME_MAX) db_256 = SPEAKER_VOLUME_MAX;
+    volume_q15 = db_to_q15(db_256);
+    gain_q15   = muted ? 0 : volume_q15;
+}
+
+void speaker_set_mute(bool mute)
+{
+    muted    = mute;
+    gain_q15 = muted ? 0 : volume_q15;
+}
+
+void speaker_set_sidetone(int16_t db_256)
+{
+    if (db_256 < SIDETONE_MIN) db_256 = SIDETONE_MIN;
+    if (db_256 > SIDETONE_MAX) db_256 = SIDETONE_MAX;
+    sidetone_db        = db_256;
+    sidetone_level_q15 = db_256 == SIDETONE_MIN ? 0 : db_to_q15(db_256);
+    sidetone_q15       = off_hook ? sidetone_level_q15 : 0;
+}
+
+int16_t speaker_sidetone(void)
+{
+    return sidetone_db;
+}
+
+void speaker_set_off_hook(bool lifted)
+{
+    off_hook     = lifted;
+    sidetone_q15 = off_hook ? sidetone_level_q15 : 0;
+}
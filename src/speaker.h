@@ -0,0 +1,66 @@
+/**
+ * @file speaker.h
+ * @brief handset earpiece playback: jitter buffer -> DMA -> PWM
+ *
+ * Samples from the USB OUT stream go into a small jitter buffer. Two
+ * chained DMA channels, paced at exactly AUDIO_SAMPLE_RATE by a DMA timer,
+ * play blocks of a third of a millisecond into the PWM compare register;
+ * each block is refilled from the jitter buffer in the DMA interrupt while
+ * the other one plays. The refill also mixes in the newest mic samples as
+ * sidetone, which is how a telephone lets you hear yourself, without the
+ * round trip through the host.
+ * Playback starts once the buffer holds the set depth, so the delay is
+ * that depth plus at most two blocks. The host paces itself to this
+ * playback through the feedback endpoint (usb_audio.cpp), so the fill
+ * stays near the depth instead of drifting with the two clocks.
+ */
+
+#ifndef SPEAKER_H
+#define SPEAKER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define EARPIECE_PIN        16  // PWM, RC low-pass into the earpiece driver
+#define SPEAKER_DEPTH_MS     3  // default jitter buffer depth, config.speaker_depth_ms
+#define SPEAKER_DEPTH_MAX_MS 8
+
+// Once at start-up, on the core that runs TinyUSB, after config_load()
+void speaker_init(void);
+
+// Play while the host has the stream open, idle at mid-level otherwise
+void speaker_start(void);
+void speaker_stop(void);
+
+// Queue samples from the OUT endpoint; what doesn't fit is dropped
+void speaker_write(const int16_t *pcm, size_t samples);
+
+// For the feedback endpoint: samples played since speaker_start(), exact
+// to the one the DMA is on, and samples waiting in the jitter buffer. Call
+// from an interrupt on core 0 so the DMA interrupt can't run in between.
+uint32_t speaker_samples_played(void);
+uint32_t speaker_fill(void);
+
+// Jitter buffer depth, from the config store at start-up; the feedback
+// endpoint keeps the fill around it
+uint8_t speaker_depth_ms(void);
+
+// Feature unit: volume in 1/256 dB and mute
+#define SPEAKER_VOLUME_MIN  (-40 * 256)
+#define SPEAKER_VOLUME_MAX  0
+#define SPEAKER_VOLUME_RES  256
+void speaker_set_volume(int16_t db_256);
+void speaker_set_mute(bool mute);
+
+// Sidetone level in 1/256 dB; SIDETONE_MIN switches it off. It only plays
+// while the handset is lifted, and only while both streams are open.
+#define SIDETONE_MIN        (-40 * 256)
+#define SIDETONE_MAX        (-6 * 256)
+#define SIDETONE_DEFAULT    (-18 * 256)
+void speaker_set_sidetone(int16_t db_256);
+int16_t speaker_sidetone(void);
+
+// From the hook switch, see hal_handset_off_hook()
+void speaker_set_off_hook(bool lifted);
+
+#endif /* SPEAKER_H */
@@ -0,0 +1,74 @@
+/**
+ * @file spsc_ring.h
+ * @brief lock-free single-producer/single-consumer ring buffer
+ *
+ * One side (typically an ISR) only calls push(), the other only pop().
+ * Head and tail are each written by one side only, so plain atomic
+ * loads/stores are enough and nothing ever has to disable interrupts.
+ */
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+template <typename T, size_t N>
+class SpscRing
+{
+	static_assert(N >= 2 && (N & (N - 1)) == 0, "ring size must be a power of two");
+
+private:
+	T items[N];
+	std::atomic<uint32_t> head{0};    // next slot to write, owned by producer
+	std::atomic<uint32_t> tail{0};    // next slot to read, owned by consumer
+	std::atomic<uint32_t> overflows{0};
+
+public:
+	// producer side, returns false (and counts it) when the ring is full
+	bool push(const T &item)
+	{
+		uint32_t h = head.load(std::memory_order_relaxed);
+		if (h - tail.load(std::memory_order_acquire) >= N)
+		{
+			overflows.store(overflows.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			return false;
+		}
+		items[h & (N - 1)] = item;
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumer side, returns false when the ring is empty
+	bool pop(T &item)
+	{
+		uint32_t t = tail.load(std::memory_order_relaxed);
+		if (t == head.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+		item = items[t & (N - 1)];
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	// items waiting, exact on the consumer side, a lower bound elsewhere
+	uint32_t size() const
+	{
+		return head.load(std::memory_order_acquire) - tail.load(std::memory_order_relaxed);
+	}
+
+	bool empty() const
+	{
+		return tail.load(std::memory_order_relaxed) == head.load(std::memory_order_acquire);
+	}
+
+	// number of pushes dropped because the ring was full
+	uint32_t dropped() const
+	{
+		return overflows.load(std::memory_order_relaxed);
+	}
+};
+
+#endif /* SPSC_RING_H */
@@ -0,0 +1,81 @@
+/**
+ * @file stats.cpp
+ * @brief latency histograms and counters, see stats.h
+ */
+
+#include <string.h>
+#include <atomic>
+
+#include "hal.h"
+#include "stats.h"
+
+static LatencyHistogram histograms[LATENCY_COUNT];
+
+// Counters are bumped from both cores and the M0+ has no atomic add, so
+// each one only ever grows on its own core; a reset just moves the baseline.
+static std::atomic<uint32_t> counters[COUNTER_COUNT];
+static uint32_t baseline[COUNTER_COUNT];
+static uint64_t reset_us = 0;
+
+static uint8_t bucket_of(uint32_t us)
+{
+    uint8_t log2 = 0;
+    while (us >>= 1)
+    {
+        ++log2;
+    }
+    return log2 <= 5 ? 0 : (log2 - 5 >= STATS_BUCKETS ? STATS_BUCKETS - 1 : log2 - 5);
+}
+
+void stats_latency(LatencyId id, uint32_t latency_us)
+{
+    if (id >= LATENCY_COUNT)
+    {
+        return;
+    }
+
+    LatencyHistogram &h = histograms[id];
+    uint16_t &bucket = h.buckets[bucket_of(latency_us)];
+    if (bucket != UINT16_MAX)
+    {
+        ++bucket;
+    }
+    ++h.count;
+    h.sum_us += latency_us;
+    if (latency_us > h.max_us)
+    {
+        h.max_us = latency_us;
+    }
+}
+
+void stats_count(CounterId id, uint32_t n)
+{
+    counters[id].store(counters[id].load(std::memory_order_relaxed) + n,
+                       std::memory_order_relaxed);
+}
+
+void stats_read_latency(LatencyId id, LatencyHistogram *out)
+{
+    *out = histograms[id];
+}
+
+void stats_read_counters(StatsCounters *out)
+{
+    uint64_t now_us = hal_time_us();
+
+    out->since_reset_ms = (uint32_t)((now_us - reset_us) / 1000);
+    for (int i = 0; i < COUNTER_COUNT; i++)
+    {
+        out->counters[i] = counters[i].load(std::memory_order_relaxed) - baseline[i];
+    }
+}
+
+void stats_reset(void)
+{
+    memset(histograms, 0, sizeof(histograms));
+    for (int i = 0; i < COUNTER_COUNT; i++)
+    {
+        baseline[i] = counters[i].load(std::memory_order_relaxed);
+    }
+    reset_us = hal_time_us();
+}
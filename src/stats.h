@@ -0,0 +1,101 @@
+/**
+ * @file stats.h
+ * @brief on-device latency histograms and event counters
+ *
+ * Read from the host as HID feature reports (see usb_descriptors.h), any
+ * SET_REPORT to one of them starts a new measurement. The report payloads
+ * are the structs below, little-endian, as they sit in memory.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define STATS_BUCKETS 16
+
+enum LatencyId
+{
+    LATENCY_DIGIT,      // last dial pulse edge -> digit report picked up by host
+    LATENCY_HOOK,       // hook edge -> telephony report picked up
+    LATENCY_HID_EP,     // report handed to the endpoint -> picked up
+    LATENCY_MIC,        // first sample of a mic packet -> packet on the bus
+    LATENCY_COUNT,
+    LATENCY_NONE = 0xFF
+};
+
+enum CounterId
+{
+    COUNTER_PULSE_BOUNCES,  // dial edges that didn't stay for the debounce window
+    COUNTER_HOOK_BOUNCES,   // same for the hook switch
+    COUNTER_BAD_DIGITS,     // digits of more than ten pulses
+    COUNTER_NOISE_PULSES,   // dial breaks too short to be a pulse, not counted
+    COUNTER_ODD_PULSES,     // pulses counted with a break/make ratio off spec
+    COUNTER_EDGE_DROPS,     // edges lost to a full capture ring
+    COUNTER_EVENT_DROPS,    // decoded events lost on the way to core 0
+    COUNTER_HID_DROPS,      // reports or macros that didn't fit the HID queue
+    COUNTER_MIC_UNDERRUNS,  // mic frames sent as silence, too few samples were in
+    COUNTER_MIC_OVERRUNS,   // jumps ahead after the host fell behind, to keep the delay down
+    COUNTER_SPK_UNDERRUNS,  // earpiece blocks that ran out of samples
+    COUNTER_SPK_OVERRUNS,   // earpiece packets (partly) dropped, buffer full
+    COUNTER_COUNT
+};
+
+// Bucket i counts latencies in [2^(i+5), 2^(i+6)) us, i.e. 64 us steps
+// doubling up to 1 s; the first and last bucket are open-ended.
+struct LatencyHistogram
+{
+    uint16_t buckets[STATS_BUCKETS];    // saturate at 65535
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t sum_us;
+};
+
+struct StatsCounters
+{
+    uint32_t since_reset_ms;
+    uint32_t counters[COUNTER_COUNT];
+};
+
+// Filled in by main.cpp from power_stats() and its boot timings, not reset
+// by stats_reset(). Boot times count from the start of the microsecond
+// timer, early in the SDK start-up; the boot ROM and second stage are before.
+struct StatsPower
+{
+    uint32_t uptime_ms;
+    uint32_t awake_ms[2];               // per core since boot, see power.h
+    uint32_t asleep_ms[2];
+    uint32_t boot_main_us;              // main() entered
+    uint32_t boot_usb_us;               // tusb_init() done
+    uint32_t boot_mount_us;             // first configured by the host, 0 until then
+    uint16_t irq_entry_cycles[2];       // core 1 GPIO interrupt, fastest and slowest of STATS_IRQ_PROBES
+};
+
+#define STATS_IRQ_PROBES 16
+
+// Filled in by dsp.cpp, reset with the rest. In clk_sys cycles, a 1 ms
+// block has 125000 of them at 125 MHz.
+#define STATS_DSP_STAGES 4
+struct StatsDsp
+{
+    uint64_t cycles[STATS_DSP_STAGES];      // per stage (dsp.h), all blocks
+    uint16_t max_cycles[STATS_DSP_STAGES];  // per stage, worst block, stops at 0xFFFF
+    uint32_t max_chain_cycles;              // whole chain, worst block
+    uint32_t blocks;
+    uint32_t stages;                        // enabled stages, see dsp_set_stages()
+    uint32_t reserved;                      // zero, keeps the size a multiple of 8
+};
+
+// Core 0 only: the HID side records all latencies
+void stats_latency(LatencyId id, uint32_t latency_us);
+
+// Each counter has one writer core, any core may count its own ones
+void stats_count(CounterId id, uint32_t n = 1);
+
+// Core 0: copy out the numbers since the last stats_reset()
+void stats_read_latency(LatencyId id, LatencyHistogram *out);
+void stats_read_counters(StatsCounters *out);
+void stats_reset(void);
+
+#endif /* STATS_H */
@@ -0,0 +1,128 @@
+/**
+ * @file timers.cpp
+ * @brief per-core timer heaps, see timers.h
+ */
+
+#include "hal.h"
+#include "timers.h"
+
+#define NOT_ARMED 0xFF
+
+struct Heap
+{
+    uint8_t ids[TIMER_COUNT];   // heap order on due[]
+    uint8_t size;
+};
+
+// the core each TimerId runs on
+static const uint8_t owner[TIMER_COUNT] = { 1, 1, 1, 0 };
+
+static Heap     heaps[2];
+static uint64_t due[TIMER_COUNT];
+static TimerFn  fns[TIMER_COUNT];
+static uint8_t  slot[TIMER_COUNT] = { NOT_ARMED, NOT_ARMED, NOT_ARMED, NOT_ARMED };
+
+static_assert(sizeof(owner) == TIMER_COUNT && sizeof(slot) == TIMER_COUNT, "one entry per TimerId");
+
+static void HAL_RAM_FUNC(place)(Heap &h, uint8_t i, uint8_t id)
+{
+    h.ids[i] = id;
+    slot[id] = i;
+}
+
+static void HAL_RAM_FUNC(sift_up)(Heap &h, uint8_t i)
+{
+    uint8_t id = h.ids[i];
+    while (i > 0)
+    {
+        uint8_t parent = (i - 1) / 2;
+        if (due[h.ids[parent]] <= due[id])
+        {
+            break;
+        }
+        place(h, i, h.ids[parent]);
+        i = parent;
+    }
+    place(h, i, id);
+}
+
+static void HAL_RAM_FUNC(sift_down)(Heap &h, uint8_t i)
+{
+    uint8_t id = h.ids[i];
+    while (true)
+    {
+        uint8_t child = 2 * i + 1;
+        if (child >= h.size)
+        {
+            break;
+        }
+        if (child + 1 < h.size && due[h.ids[child + 1]] < due[h.ids[child]])
+        {
+            child++;
+        }
+        if (due[id] <= due[h.ids[child]])
+        {
+            break;
+        }
+        place(h, i, h.ids[child]);
+        i = child;
+    }
+    place(h, i, id);
+}
+
+void HAL_RAM_FUNC(timer_at)(TimerId id, uint64_t due_us, TimerFn fn)
+{
+    Heap &h = heaps[owner[id]];
+
+    due[id] = due_us;
+    fns[id] = fn;
+    if (slot[id] == NOT_ARMED)
+    {
+        place(h, h.size++, id);
+    }
+    // moved either way, or new at the bottom
+    sift_up(h, slot[id]);
+    sift_down(h, slot[id]);
+}
+
+void HAL_RAM_FUNC(timer_cancel)(TimerId id)
+{
+    uint8_t i = slot[id];
+    if (i == NOT_ARMED)
+    {
+        return;
+    }
+
+    Heap   &h    = heaps[owner[id]];
+    uint8_t last = h.ids[--h.size];
+    slot[id] = NOT_ARMED;
+    if (i < h.size)
+    {
+        place(h, i, last);
+        sift_up(h, i);
+        sift_down(h, slot[last]);
+    }
+}
+
+bool timer_armed(TimerId id)
+{
+    return slot[id] != NOT_ARMED;
+}
+
+void HAL_RAM_FUNC(timers_run)(uint8_t core, uint64_t now_us)
+{
+    Heap &h = heaps[core];
+
+    while (h.size && due[h.ids[0]] <= now_us)
+    {
+        TimerId id = (TimerId)h.ids[0];
+        timer_cancel(id);
+        fns[id](due[id]);
+    }
+}
+
+uint64_t timers_next_us(uint8_t core)
+{
+    const Heap &h = heaps[core];
+    return h.size ? due[h.ids[0]] : UINT64_MAX;
+}
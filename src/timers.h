@@ -0,0 +1,44 @@
+/**
+ * @file timers.h
+ * @brief one-shot deadline timers, a min-heap per core
+ *
+ * Every timed behaviour has a TimerId, and each id belongs to one core.
+ * timer_at() arms or moves a timer; the core's loop calls timers_run(),
+ * which fires the due ones in deadline order, and then sleeps until
+ * timers_next_us() on a hardware timer alarm (power_sleep_until()) or the
+ * next interrupt. So nothing timed is polled: a pass does only the work
+ * that is due or that an interrupt brought in.
+ *
+ * Timers are only touched from their own core, no locking.
+ */
+
+#ifndef TIMERS_H
+#define TIMERS_H
+
+#include <stdint.h>
+
+enum TimerId
+{
+    TIMER_DEBOUNCE,         // core 1: next debounce tick while a pin settles
+    TIMER_DIGIT_END,        // core 1: learned silence after the last pulse
+    TIMER_CALIBRATION,      // core 1: save a drifted dial calibration
+    TIMER_HID_PAUSE,        // core 0: end of a pause in the HID queue
+    TIMER_COUNT
+};
+
+// Called once, on the timer's core, with the deadline it was armed for
+typedef void (*TimerFn)(uint64_t due_us);
+
+// Arm the timer, or move it if it is armed already
+void timer_at(TimerId id, uint64_t due_us, TimerFn fn);
+void timer_cancel(TimerId id);
+bool timer_armed(TimerId id);
+
+// Fire every timer of core that is due at now_us. A callback may re-arm
+// its own timer or any other of the same core.
+void timers_run(uint8_t core, uint64_t now_us);
+
+// Earliest deadline on core, UINT64_MAX if no timer is armed
+uint64_t timers_next_us(uint8_t core);
+
+#endif /* TIMERS_H */
@@ -101,9 +101,64 @@ extern "C"
 #define CFG_TUD_MSC 0
 #define CFG_TUD_MIDI 0
 #define CFG_TUD_VENDOR 0
+#define CFG_TUD_AUDIO 1
 
 // HID buffer size Should be sufficient to hold ID (if any) + Data
-#define CFG_TUD_HID_EP_BUFSIZE 16
+// (the largest feature report is StatsDsp, 1 + 56 bytes; main.cpp checks)
+#define CFG_TUD_HID_EP_BUFSIZE 64
+
+//------------- AUDIO -------------//
+// 48 kHz mono 16-bit microphone and earpiece, one 1 ms packet per frame
+#define AUDIO_SAMPLE_RATE 48000
+#define AUDIO_SAMPLES_PER_FRAME (AUDIO_SAMPLE_RATE / 1000)
+
+// Must match desc_configuration in usb_descriptors.c
+#define TUD_AUDIO_AS_DESC_LEN (TUD_AUDIO_DESC_STD_AS_INT_LEN                  \
+                               + TUD_AUDIO_DESC_STD_AS_INT_LEN                \
+                               + TUD_AUDIO_DESC_CS_AS_INT_LEN                 \
+                               + TUD_AUDIO_DESC_TYPE_I_FORMAT_LEN             \
+                               + TUD_AUDIO_DESC_STD_AS_ISO_EP_LEN             \
+                               + TUD_AUDIO_DESC_CS_AS_ISO_EP_LEN)
+
+#define TUD_AUDIO_HEADSET_DESC_LEN (TUD_AUDIO_DESC_IAD_LEN                        \
+                                    + TUD_AUDIO_DESC_STD_AC_LEN                   \
+                                    + TUD_AUDIO_DESC_CS_AC_LEN                    \
+                                    + TUD_AUDIO_DESC_CLK_SRC_LEN                  \
+                                    + TUD_AUDIO_DESC_INPUT_TERM_LEN               \
+                                    + TUD_AUDIO_DESC_FEATURE_UNIT_ONE_CHANNEL_LEN \
+                                    + TUD_AUDIO_DESC_OUTPUT_TERM_LEN              \
+                                    + TUD_AUDIO_DESC_INPUT_TERM_LEN               \
+                                    + TUD_AUDIO_DESC_FEATURE_UNIT_ONE_CHANNEL_LEN \
+                                    + TUD_AUDIO_DESC_OUTPUT_TERM_LEN              \
+                                    + TUD_AUDIO_AS_DESC_LEN                       \
+                                    + TUD_AUDIO_AS_DESC_LEN                       \
+                                    + TUD_AUDIO_DESC_STD_AS_ISO_FB_EP_LEN)
+
+#define CFG_TUD_AUDIO_FUNC_1_DESC_LEN TUD_AUDIO_HEADSET_DESC_LEN
+#define CFG_TUD_AUDIO_FUNC_1_N_AS_INT 2
+#define CFG_TUD_AUDIO_FUNC_1_CTRL_BUF_SZ 64
+
+#define CFG_TUD_AUDIO_ENABLE_EP_IN 1
+#define CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX 2
+#define CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX 1
+// room for one extra sample per packet, for when clocks drift
+#define CFG_TUD_AUDIO_EP_SZ_IN ((AUDIO_SAMPLES_PER_FRAME + 1) * CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX * CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX)
+#define CFG_TUD_AUDIO_FUNC_1_EP_IN_SZ_MAX CFG_TUD_AUDIO_EP_SZ_IN
+#define CFG_TUD_AUDIO_FUNC_1_EP_IN_SW_BUF_SZ CFG_TUD_AUDIO_EP_SZ_IN
+
+#define CFG_TUD_AUDIO_ENABLE_EP_OUT 1
+#define CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_RX 2
+#define CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX 1
+#define CFG_TUD_AUDIO_EP_SZ_OUT ((AUDIO_SAMPLES_PER_FRAME + 1) * CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_RX * CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX)
+#define CFG_TUD_AUDIO_FUNC_1_EP_OUT_SZ_MAX CFG_TUD_AUDIO_EP_SZ_OUT
+// a few packets, the jitter buffer proper is in speaker.cpp
+#define CFG_TUD_AUDIO_FUNC_1_EP_OUT_SW_BUF_SZ (4 * CFG_TUD_AUDIO_EP_SZ_OUT)
+// the rate comes from usb_audio.cpp, tud_audio_feedback_interval_isr()
+#define CFG_TUD_AUDIO_ENABLE_FEEDBACK_EP 1
+// usb_audio.cpp computes the feedback in 16.16, which the Windows UAC2
+// driver needs even on full speed and Linux and macOS accept. So no
+// CFG_TUD_AUDIO_ENABLE_FEEDBACK_FORMAT_CORRECTION: with it, TinyUSB would
+// take 16.16 in and shift it down to 10.14 on full speed.
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,273 @@
+/**
+ * @file usb_audio.cpp
+ * @brief TinyUSB audio class callbacks: clock, feature unit and streams
+ */
+
+#include "tusb.h"
+
+#include "usb_descriptors.h"
+#include "usb_audio.h"
+#include "mic.h"
+#include "speaker.h"
+#include "stats.h"
+#include "pico/time.h"
+
+static bool    mic_muted   = false;
+static bool    call_muted  = false;
+static bool    spk_muted   = false;
+static int16_t spk_volume  = SPEAKER_VOLUME_MAX;
+
+// Feedback: samples per frame in 16.16, measured over a sliding window of
+// FB_WINDOW frames that moves on every FB_STEP frames. TinyUSB sends it as
+// it is, and every host reads 16.16 (see tusb_config.h).
+#define FB_FRACTION_BITS 16
+#define FB_WINDOW_SHIFT  10
+#define FB_STEP_SHIFT    7
+#define FB_PULL_SHIFT    10             // fill error of 1 -> 2^-10 sample per frame
+#define FB_MARKS         (1u << (FB_WINDOW_SHIFT - FB_STEP_SHIFT))
+#define FB_NOMINAL       ((uint32_t)AUDIO_SAMPLES_PER_FRAME << FB_FRACTION_BITS)
+
+static volatile uint32_t fb_frames;
+static uint32_t fb_marks[FB_MARKS];     // speaker_samples_played() per step
+static uint32_t fb_fill_sum;
+
+void usb_audio_set_call_mute(bool muted)
+{
+    call_muted = muted;
+}
+
+//--------------------------------------------------------------------+
+// Class requests
+//--------------------------------------------------------------------+
+
+// Invoked when audio class specific get request received for an entity
+bool tud_audio_get_req_entity_cb(uint8_t rhport, tusb_control_request_t const *p_request)
+{
+    uint8_t ctrl   = TU_U16_HIGH(p_request->wValue);
+    uint8_t entity = TU_U16_HIGH(p_request->wIndex);
+
+    if (entity == UAC_ENTITY_CLOCK && ctrl == AUDIO_CS_CTRL_SAM_FREQ)
+    {
+        if (p_request->bRequest == AUDIO_CS_REQ_CUR)
+        {
+            audio_control_cur_4_t freq = { (int32_t)AUDIO_SAMPLE_RATE };
+            return tud_audio_buffer_and_schedule_control_xfer(rhport, p_request, &freq, sizeof(freq));
+        }
+        if (p_request->bRequest == AUDIO_CS_REQ_RANGE)
+        {
+            audio_control_range_4_n_t(1) range;
+            range.wNumSubRanges    = 1;
+            range.subrange[0].bMin = AUDIO_SAMPLE_RATE;
+            range.subrange[0].bMax = AUDIO_SAMPLE_RATE;
+            range.subrange[0].bRes = 0;
+            return tud_audio_buffer_and_schedule_control_xfer(rhport, p_request, &range, sizeof(range));
+        }
+    }
+    else if (entity == UAC_ENTITY_CLOCK && ctrl == AUDIO_CS_CTRL_CLK_VALID &&
+             p_request->bRequest == AUDIO_CS_REQ_CUR)
+    {
+        audio_control_cur_1_t valid = { 1 };
+        return tud_audio_buffer_and_schedule_control_xfer(rhport, p_request, &valid, sizeof(valid));
+    }
+    else if (entity == UAC_ENTITY_MIC_FEATURE && ctrl == AUDIO_FU_CTRL_MUTE &&
+             p_request->bRequest == AUDIO_CS_REQ_CUR)
+    {
+        audio_control_cur_1_t mute = { mic_muted };
+        return tud_audio_buffer_and_schedule_control_xfer(rhport, p_request, &mute, sizeof(mute));
+    }
+    else if (entity == UAC_ENTITY_SPK_FEATURE && ctrl == AUDIO_FU_CTRL_MUTE &&
+             p_request->bRequest == AUDIO_CS_REQ_CUR)
+    {
+        audio_control_cur_1_t mute = { spk_muted };
+        return tud_audio_buffer_and_schedule_control_xfer(rhport, p_request, &mute, sizeof(mute));
+    }
+    else if (entity == UAC_ENTITY_SPK_FEATURE && ctrl == AUDIO_FU_CTRL_VOLUME)
+    {
+        if (p_request->bRequest == AUDIO_CS_REQ_CUR)
+        {
+            audio_control_cur_2_t volume = { spk_volume };
+            return tud_audio_buffer_and_schedule_control_xfer(rhport, p_request, &volume, sizeof(volume));
+        }
+        if (p_request->bRequest == AUDIO_CS_REQ_RANGE)
+        {
+            audio_control_range_2_n_t(1) range;
+            range.wNumSubRanges    = 1;
+            range.subrange[0].bMin = SPEAKER_VOLUME_MIN;
+            range.subrange[0].bMax = SPEAKER_VOLUME_MAX;
+            range.subrange[0].bRes = SPEAKER_VOLUME_RES;
+            return tud_audio_buffer_and_schedule_control_xfer(rhport, p_request, &range, sizeof(range));
+        }
+    }
+
+    return false; // stall anything else
+}
+
+// Invoked when audio class specific set request received for an entity
+bool tud_audio_set_req_entity_cb(uint8_t rhport, tusb_control_request_t const *p_request, uint8_t *buf)
+{
+    (void)rhport;
+    uint8_t ctrl   = TU_U16_HIGH(p_request->wValue);
+    uint8_t entity = TU_U16_HIGH(p_request->wIndex);
+
+    if (entity == UAC_ENTITY_MIC_FEATURE && ctrl == AUDIO_FU_CTRL_MUTE &&
+        p_request->bRequest == AUDIO_CS_REQ_CUR && p_request->wLength >= 1)
+    {
+        mic_muted = buf[0];
+        return true;
+    }
+    if (entity == UAC_ENTITY_SPK_FEATURE && ctrl == AUDIO_FU_CTRL_MUTE &&
+        p_request->bRequest == AUDIO_CS_REQ_CUR && p_request->wLength >= 1)
+    {
+        spk_muted = buf[0];
+        speaker_set_mute(spk_muted);
+        return true;
+    }
+    if (entity == UAC_ENTITY_SPK_FEATURE && ctrl == AUDIO_FU_CTRL_VOLUME &&
+        p_request->bRequest == AUDIO_CS_REQ_CUR && p_request->wLength >= 2)
+    {
+        spk_volume = (int16_t)tu_le16toh(tu_unaligned_read16(buf));
+        if (spk_volume < SPEAKER_VOLUME_MIN) spk_volume = SPEAKER_VOLUME_MIN;
+        if (spk_volume > SPEAKER_VOLUME_MAX) spk_volume = SPEAKER_VOLUME_MAX;
+        speaker_set_volume(spk_volume);
+        return true;
+    }
+
+    return false; // the clock is fixed
+}
+
+//--------------------------------------------------------------------+
+// Streams
+//--------------------------------------------------------------------+
+
+// Invoked when the host selects an alternate setting: 1 opens the stream
+bool tud_audio_set_itf_cb(uint8_t rhport, tusb_control_request_t const *p_request)
+{
+    (void)rhport;
+    uint8_t itf = TU_U16_LOW(p_request->wIndex);
+    uint8_t alt = TU_U16_LOW(p_request->wValue);
+
+    if (itf == ITF_NUM_AUDIO_STREAMING_MIC)
+    {
+        if (alt) mic_start();
+        else     mic_stop();
+    }
+    else if (itf == ITF_NUM_AUDIO_STREAMING_SPK)
+    {
+        if (alt)
+        {
+            fb_frames   = 0;
+            fb_fill_sum = 0;
+            tud_audio_fb_set(FB_NOMINAL);
+            speaker_start();
+        }
+        else
+        {
+            speaker_stop();
+        }
+    }
+    return true;
+}
+
+// Invoked when the host closes a stream (alternate 0, or a bus reset)
+bool tud_audio_set_itf_close_EP_cb(uint8_t rhport, tusb_control_request_t const *p_request)
+{
+    (void)rhport;
+    uint8_t itf = TU_U16_LOW(p_request->wIndex);
+
+    if (itf == ITF_NUM_AUDIO_STREAMING_MIC)
+    {
+        mic_stop();
+    }
+    else if (itf == ITF_NUM_AUDIO_STREAMING_SPK)
+    {
+        speaker_stop();
+    }
+    return true;
+}
+
+// Invoked once per frame, when the previous IN packet has gone out: queue
+// exactly one packet for the next frame
+bool tud_audio_tx_done_pre_load_cb(uint8_t rhport, uint8_t itf, uint8_t ep_in, uint8_t cur_alt_setting)
+{
+    static const int16_t silence[AUDIO_SAMPLES_PER_FRAME + 1] = { 0 };
+    (void)rhport;
+    (void)itf;
+    (void)ep_in;
+    (void)cur_alt_setting;
+
+    size_t         samples = AUDIO_SAMPLES_PER_FRAME;
+    uint64_t       captured_us;
+    const int16_t *pcm = mic_frame(&samples, &captured_us);
+
+    if (pcm)
+    {
+        // the packet goes on the bus one frame from now
+        stats_latency(LATENCY_MIC, (uint32_t)(time_us_64() + 1000 - captured_us));
+    }
+    if (!pcm || mic_muted || call_muted)
+    {
+        pcm = silence;
+    }
+    tud_audio_write(pcm, (uint16_t)(samples * sizeof(pcm[0])));
+    return true;
+}
+
+// Invoked after an OUT packet has been moved into the FIFO: hand it to the
+// jitter buffer. One more sample than a frame fits, the host may send 49
+// now and then to catch up.
+bool tud_audio_rx_done_post_read_cb(uint8_t rhport, uint16_t n_bytes_received, uint8_t func_id,
+                                    uint8_t ep_out, uint8_t cur_alt_setting)
+{
+    (void)rhport;
+    (void)n_bytes_received;
+    (void)func_id;
+    (void)ep_out;
+    (void)cur_alt_setting;
+
+    int16_t  pcm[AUDIO_SAMPLES_PER_FRAME + 1];
+    uint16_t n;
+    while ((n = tud_audio_read(pcm, sizeof(pcm))) > 0)
+    {
+        speaker_write(pcm, n / sizeof(pcm[0]));
+    }
+    return true;
+}
+
+// Invoked from the SOF interrupt every frame while the earpiece stream is
+// open. The samples the DMA really played over the last 1024 frames give
+// the device rate in host frames; that is the feedback, plus a small pull
+// towards the set depth so the fill doesn't sit wherever it started.
+void tud_audio_feedback_interval_isr(uint8_t func_id, uint32_t frame_number, uint8_t interval_shift)
+{
+    (void)frame_number;
+    (void)interval_shift;
+
+    fb_fill_sum += speaker_fill();
+    uint32_t frames = fb_frames + 1;
+    fb_frames = frames;
+    if (frames & ((1u << FB_STEP_SHIFT) - 1))
+    {
+        return;
+    }
+
+    uint32_t  played = speaker_samples_played();
+    uint32_t  step   = frames >> FB_STEP_SHIFT;
+    uint32_t &mark   = fb_marks[step % FB_MARKS];
+
+    if (step > FB_MARKS)    // the mark is from a full window ago
+    {
+        int32_t fill  = (int32_t)(fb_fill_sum >> FB_STEP_SHIFT);
+        int32_t error = (int32_t)(speaker_depth_ms() * AUDIO_SAMPLES_PER_FRAME) - fill;
+
+        // a packet's worth of fill error is gone in about a second
+        int32_t fb = (int32_t)((played - mark) << (FB_FRACTION_BITS - FB_WINDOW_SHIFT)) +
+                     error * (1 << (FB_FRACTION_BITS - FB_PULL_SHIFT));
+
+        // stay within one sample per frame of nominal, whatever happens
+        int32_t lo = (int32_t)FB_NOMINAL - (1 << FB_FRACTION_BITS);
+        int32_t hi = (int32_t)FB_NOMINAL + (1 << FB_FRACTION_BITS);
+        tud_audio_n_fb_set(func_id, (uint32_t)(fb < lo ? lo : fb > hi ? hi : fb));
+    }
+    mark        = played;
+    fb_fill_sum = 0;
+}
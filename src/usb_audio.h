@@ -0,0 +1,13 @@
+/**
+ * @file usb_audio.h
+ * @brief the few audio controls that don't come from the audio class
+ */
+
+#ifndef USB_AUDIO_H
+#define USB_AUDIO_H
+
+// The call app's mute (the telephony Mute LED), on top of the feature
+// unit's; the mic sends silence while either is set
+void usb_audio_set_call_mute(bool muted);
+
+#endif /* USB_AUDIO_H */
@@ -34,7 +34,7 @@
  */
 #define _PID_MAP(itf, n) ((CFG_TUD_##itf) << (n))
 #define USB_PID (0x4000 | _PID_MAP(CDC, 0) | _PID_MAP(MSC, 1) | _PID_MAP(HID, 2) | \
-                 _PID_MAP(MIDI, 3) | _PID_MAP(VENDOR, 4))
+                 _PID_MAP(MIDI, 3) | _PID_MAP(VENDOR, 4) | _PID_MAP(AUDIO, 5))
 
 #define USB_VID 0xcafe
 #define USB_BCD 0x0200
@@ -47,9 +47,10 @@ tusb_desc_device_t const desc_device =
         .bLength = sizeof(tusb_desc_device_t),
         .bDescriptorType = TUSB_DESC_DEVICE,
         .bcdUSB = USB_BCD,
-        .bDeviceClass = 0x00,
-        .bDeviceSubClass = 0x00,
-        .bDeviceProtocol = 0x00,
+        // the audio function uses an interface association descriptor
+        .bDeviceClass = TUSB_CLASS_MISC,
+        .bDeviceSubClass = MISC_SUBCLASS_COMMON,
+        .bDeviceProtocol = MISC_PROTOCOL_IAD,
         .bMaxPacketSize0 = CFG_TUD_ENDPOINT0_SIZE,
 
         .idVendor = USB_VID,
@@ -73,7 +74,81 @@ uint8_t const *tud_descriptor_device_cb(void)
 // HID Report Descriptor
 //--------------------------------------------------------------------+
 
-uint8_t const desc_hid_report[] = {TUD_HID_REPORT_DESC_KEYBOARD(HID_REPORT_ID(REPORT_ID_KEYBOARD))};
+// One opaque vendor-defined feature report
+#define VENDOR_FEATURE(report_id, len)                     \
+    HID_REPORT_ID(report_id)                              \
+    HID_USAGE(report_id),                                 \
+    HID_LOGICAL_MIN(0x00),                                \
+    HID_LOGICAL_MAX_N(0xff, 2),                           \
+    HID_REPORT_SIZE(8),                                   \
+    HID_REPORT_COUNT(len),                                \
+    HID_FEATURE(HID_DATA | HID_VARIABLE | HID_ABSOLUTE)
+
+// telephony headset: hook switch and mute in, call state LEDs out
+#define TELEPHONY_HEADSET(report_id)                                          \
+    HID_USAGE_PAGE(HID_USAGE_PAGE_TELEPHONY),                                 \
+    HID_USAGE(0x05),                    /* Headset */                         \
+    HID_COLLECTION(HID_COLLECTION_APPLICATION),                               \
+        HID_REPORT_ID(report_id)                                              \
+        HID_LOGICAL_MIN(0),                                                   \
+        HID_LOGICAL_MAX(1),                                                   \
+        HID_REPORT_SIZE(1),                                                   \
+        HID_REPORT_COUNT(1),                                                  \
+        HID_USAGE(0x20),                /* Hook Switch */                     \
+        HID_INPUT(HID_DATA | HID_VARIABLE | HID_ABSOLUTE),                    \
+        HID_USAGE(0x2F),                /* Phone Mute, a toggle button */     \
+        HID_INPUT(HID_DATA | HID_VARIABLE | HID_RELATIVE),                    \
+        HID_REPORT_COUNT(6),                                                  \
+        HID_INPUT(HID_CONSTANT),                                              \
+                                                                              \
+        HID_USAGE_PAGE(HID_USAGE_PAGE_LED),                                   \
+        HID_USAGE(0x17),                /* Off-Hook */                        \
+        HID_USAGE(0x18),                /* Ring */                            \
+        HID_USAGE(0x09),                /* Mute */                            \
+        HID_USAGE(0x20),                /* Hold */                            \
+        HID_REPORT_COUNT(4),                                                  \
+        HID_OUTPUT(HID_DATA | HID_VARIABLE | HID_ABSOLUTE),                   \
+        HID_REPORT_COUNT(4),                                                  \
+        HID_OUTPUT(HID_CONSTANT),                                             \
+    HID_COLLECTION_END
+
+// the keyboard and headset of one more line
+#define LINE_COLLECTIONS(line)                                                \
+    TUD_HID_REPORT_DESC_KEYBOARD(HID_REPORT_ID(REPORT_ID_KEYBOARD_LINE##line)), \
+    TELEPHONY_HEADSET(REPORT_ID_TELEPHONY_LINE##line),
+
+_Static_assert(DIAL_LINES >= 1 && DIAL_LINES <= 4, "DIAL_LINES is 1-4");
+
+uint8_t const desc_hid_report[] = {
+    TUD_HID_REPORT_DESC_KEYBOARD(HID_REPORT_ID(REPORT_ID_KEYBOARD)),
+
+    // latency histograms and counters (stats.h), and settings
+    HID_USAGE_PAGE_N(HID_USAGE_PAGE_VENDOR, 2),
+    HID_USAGE(0x01),
+    HID_COLLECTION(HID_COLLECTION_APPLICATION),
+        VENDOR_FEATURE(REPORT_ID_STATS_DIGIT, STATS_LATENCY_REPORT_LEN),
+        VENDOR_FEATURE(REPORT_ID_STATS_HOOK, STATS_LATENCY_REPORT_LEN),
+        VENDOR_FEATURE(REPORT_ID_STATS_HID_EP, STATS_LATENCY_REPORT_LEN),
+        VENDOR_FEATURE(REPORT_ID_STATS_COUNTERS, STATS_COUNTERS_REPORT_LEN),
+        VENDOR_FEATURE(REPORT_ID_STATS_MIC, STATS_LATENCY_REPORT_LEN),
+        VENDOR_FEATURE(REPORT_ID_STATS_POWER, STATS_POWER_REPORT_LEN),
+        VENDOR_FEATURE(REPORT_ID_STATS_DSP, STATS_DSP_REPORT_LEN),
+        VENDOR_FEATURE(REPORT_ID_SIDETONE, SIDETONE_REPORT_LEN),
+        VENDOR_FEATURE(REPORT_ID_CONFIG, CONFIG_REPORT_LEN),
+    HID_COLLECTION_END,
+
+    TELEPHONY_HEADSET(REPORT_ID_TELEPHONY),
+
+#if DIAL_LINES > 1
+    LINE_COLLECTIONS(1)
+#endif
+#if DIAL_LINES > 2
+    LINE_COLLECTIONS(2)
+#endif
+#if DIAL_LINES > 3
+    LINE_COLLECTIONS(3)
+#endif
+};
 
 // Invoked when received GET HID REPORT DESCRIPTOR
 // Application return pointer to descriptor
@@ -88,15 +163,12 @@ uint8_t const *tud_hid_descriptor_report_cb(uint8_t instance)
 // Configuration Descriptor
 //--------------------------------------------------------------------+
 
-enum
-{
-    ITF_NUM_HID,
-    ITF_NUM_TOTAL
-};
-
-#define CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_HID_DESC_LEN)
+#define CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_HID_DESC_LEN + CFG_TUD_AUDIO_FUNC_1_DESC_LEN)
 
 #define EPNUM_HID 0x81
+#define EPNUM_AUDIO_MIC 0x82
+#define EPNUM_AUDIO_SPK 0x03
+#define EPNUM_AUDIO_FB  0x83
 
 uint8_t const desc_configuration[] =
     {
@@ -104,7 +176,59 @@ uint8_t const desc_configuration[] =
         TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
 
         // Interface number, string index, protocol, report descriptor len, EP In address, size & polling interval
-        TUD_HID_DESCRIPTOR(ITF_NUM_HID, 0, HID_ITF_PROTOCOL_NONE, sizeof(desc_hid_report), EPNUM_HID, CFG_TUD_HID_EP_BUFSIZE, 5)};
+        TUD_HID_DESCRIPTOR(ITF_NUM_HID, 0, HID_ITF_PROTOCOL_NONE, sizeof(desc_hid_report), EPNUM_HID, CFG_TUD_HID_EP_BUFSIZE, 5),
+
+        // Audio function: handset mic -> feature unit -> USB and USB -> feature
+        // unit -> earpiece, both on one fixed clock
+        TUD_AUDIO_DESC_IAD(ITF_NUM_AUDIO_CONTROL, 3, 0),
+        TUD_AUDIO_DESC_STD_AC(ITF_NUM_AUDIO_CONTROL, 0, 0),
+        TUD_AUDIO_DESC_CS_AC(0x0200, AUDIO_FUNC_HEADSET,
+                             TUD_AUDIO_DESC_CLK_SRC_LEN +
+                                 2 * (TUD_AUDIO_DESC_INPUT_TERM_LEN + TUD_AUDIO_DESC_FEATURE_UNIT_ONE_CHANNEL_LEN +
+                                      TUD_AUDIO_DESC_OUTPUT_TERM_LEN),
+                             AUDIO_CS_AS_INTERFACE_CTRL_LATENCY_POS),
+        TUD_AUDIO_DESC_CLK_SRC(UAC_ENTITY_CLOCK, AUDIO_CLOCK_SOURCE_ATT_INT_FIX_CLK,
+                               AUDIO_CTRL_R << AUDIO_CLOCK_SOURCE_CTRL_CLK_FRQ_POS, UAC_ENTITY_MIC_TERMINAL, 0),
+        TUD_AUDIO_DESC_INPUT_TERM(UAC_ENTITY_MIC_TERMINAL, AUDIO_TERM_TYPE_IN_GENERIC_MIC, 0,
+                                  UAC_ENTITY_CLOCK, 1, AUDIO_CHANNEL_CONFIG_NON_PREDEFINED, 0, 0, 0),
+        TUD_AUDIO_DESC_FEATURE_UNIT_ONE_CHANNEL(UAC_ENTITY_MIC_FEATURE, UAC_ENTITY_MIC_TERMINAL,
+                                                AUDIO_CTRL_RW << AUDIO_FEATURE_UNIT_CTRL_MUTE_POS, 0, 0),
+        TUD_AUDIO_DESC_OUTPUT_TERM(UAC_ENTITY_MIC_USB, AUDIO_TERM_TYPE_USB_STREAMING, 0,
+                                   UAC_ENTITY_MIC_FEATURE, UAC_ENTITY_CLOCK, 0, 0),
+        TUD_AUDIO_DESC_INPUT_TERM(UAC_ENTITY_SPK_USB, AUDIO_TERM_TYPE_USB_STREAMING, 0,
+                                  UAC_ENTITY_CLOCK, 1, AUDIO_CHANNEL_CONFIG_NON_PREDEFINED, 0, 0, 0),
+        TUD_AUDIO_DESC_FEATURE_UNIT_ONE_CHANNEL(UAC_ENTITY_SPK_FEATURE, UAC_ENTITY_SPK_USB,
+                                                AUDIO_CTRL_RW << AUDIO_FEATURE_UNIT_CTRL_MUTE_POS |
+                                                    AUDIO_CTRL_RW << AUDIO_FEATURE_UNIT_CTRL_VOLUME_POS,
+                                                0, 0),
+        TUD_AUDIO_DESC_OUTPUT_TERM(UAC_ENTITY_SPK_TERMINAL, AUDIO_TERM_TYPE_OUT_HEADPHONES, 0,
+                                   UAC_ENTITY_SPK_FEATURE, UAC_ENTITY_CLOCK, 0, 0),
+
+        // Mic stream: alternate 0 is idle, alternate 1 streams
+        TUD_AUDIO_DESC_STD_AS_INT(ITF_NUM_AUDIO_STREAMING_MIC, 0, 0, 0),
+        TUD_AUDIO_DESC_STD_AS_INT(ITF_NUM_AUDIO_STREAMING_MIC, 1, 1, 0),
+        TUD_AUDIO_DESC_CS_AS_INT(UAC_ENTITY_MIC_USB, AUDIO_CTRL_NONE, AUDIO_FORMAT_TYPE_I, AUDIO_DATA_FORMAT_TYPE_I_PCM,
+                                 1, AUDIO_CHANNEL_CONFIG_NON_PREDEFINED, 0),
+        TUD_AUDIO_DESC_TYPE_I_FORMAT(2, 16),
+        TUD_AUDIO_DESC_STD_AS_ISO_EP(EPNUM_AUDIO_MIC,
+                                     TUSB_XFER_ISOCHRONOUS | TUSB_ISO_EP_ATT_ASYNCHRONOUS | TUSB_ISO_EP_ATT_DATA,
+                                     CFG_TUD_AUDIO_EP_SZ_IN, 1),
+        TUD_AUDIO_DESC_CS_AS_ISO_EP(AUDIO_CS_AS_ISO_DATA_EP_ATT_NON_MAX_PACKETS_OK, AUDIO_CTRL_NONE,
+                                    AUDIO_CS_AS_ISO_DATA_EP_LOCK_DELAY_UNIT_UNDEFINED, 0),
+
+        // Earpiece stream: asynchronous, the device plays on its own clock
+        // and tells the host how fast through the feedback endpoint
+        TUD_AUDIO_DESC_STD_AS_INT(ITF_NUM_AUDIO_STREAMING_SPK, 0, 0, 0),
+        TUD_AUDIO_DESC_STD_AS_INT(ITF_NUM_AUDIO_STREAMING_SPK, 1, 2, 0),
+        TUD_AUDIO_DESC_CS_AS_INT(UAC_ENTITY_SPK_USB, AUDIO_CTRL_NONE, AUDIO_FORMAT_TYPE_I, AUDIO_DATA_FORMAT_TYPE_I_PCM,
+                                 1, AUDIO_CHANNEL_CONFIG_NON_PREDEFINED, 0),
+        TUD_AUDIO_DESC_TYPE_I_FORMAT(2, 16),
+        TUD_AUDIO_DESC_STD_AS_ISO_EP(EPNUM_AUDIO_SPK,
+                                     TUSB_XFER_ISOCHRONOUS | TUSB_ISO_EP_ATT_ASYNCHRONOUS | TUSB_ISO_EP_ATT_DATA,
+                                     CFG_TUD_AUDIO_EP_SZ_OUT, 1),
+        TUD_AUDIO_DESC_CS_AS_ISO_EP(AUDIO_CS_AS_ISO_DATA_EP_ATT_NON_MAX_PACKETS_OK, AUDIO_CTRL_NONE,
+                                    AUDIO_CS_AS_ISO_DATA_EP_LOCK_DELAY_UNIT_UNDEFINED, 0),
+        TUD_AUDIO_DESC_STD_AS_ISO_FB_EP(EPNUM_AUDIO_FB, 1)};
 
 #if TUD_OPT_HIGH_SPEED
 // Per USB specs: high speed capable device must report device_qualifier and other_speed_configuration
@@ -25,9 +25,72 @@
 #ifndef USB_DESCRIPTORS_H_
 #define USB_DESCRIPTORS_H_
 
+#include <stdint.h>
+
+// Handsets on one controller, 1-4 (DIALOGUE_LINES in CMake). Line 0 has
+// the audio function; every line has its own keyboard and telephony
+// headset collection, so the host can tell the phones apart.
+#ifndef DIAL_LINES
+#define DIAL_LINES 1
+#endif
+enum
+{
+    REPORT_ID_KEYBOARD = 1,
+    REPORT_ID_STATS_DIGIT,      // feature, LatencyHistogram (stats.h)
+    REPORT_ID_STATS_HOOK,       // feature, LatencyHistogram
+    REPORT_ID_STATS_HID_EP,     // feature, LatencyHistogram
+    REPORT_ID_STATS_COUNTERS,   // feature, StatsCounters
+    REPORT_ID_STATS_MIC,        // feature, LatencyHistogram
+    REPORT_ID_STATS_POWER,      // feature, StatsPower
+    REPORT_ID_STATS_DSP,        // feature, StatsDsp; SET takes the stage mask
+    REPORT_ID_SIDETONE,         // feature, int16 sidetone level in 1/256 dB
+    REPORT_ID_TELEPHONY,        // input PHONE_* buttons, output PHONE_LED_* (phone.h)
+    REPORT_ID_CONFIG,           // feature, Config (config.h)
+    REPORT_ID_KEYBOARD_LINE1,   // lines 1-3, if built with them: the same
+    REPORT_ID_KEYBOARD_LINE2,   // as REPORT_ID_KEYBOARD and
+    REPORT_ID_KEYBOARD_LINE3,   // REPORT_ID_TELEPHONY of line 0
+    REPORT_ID_TELEPHONY_LINE1,
+    REPORT_ID_TELEPHONY_LINE2,
+    REPORT_ID_TELEPHONY_LINE3
+};
+
+static inline uint8_t report_id_keyboard(uint8_t line)
+{
+    return line ? (uint8_t)(REPORT_ID_KEYBOARD_LINE1 + line - 1) : (uint8_t)REPORT_ID_KEYBOARD;
+}
+
+static inline uint8_t report_id_telephony(uint8_t line)
+{
+    return line ? (uint8_t)(REPORT_ID_TELEPHONY_LINE1 + line - 1) : (uint8_t)REPORT_ID_TELEPHONY;
+}
+
+// payload bytes after the report ID
+#define STATS_LATENCY_REPORT_LEN   48
+#define STATS_COUNTERS_REPORT_LEN  52
+#define STATS_POWER_REPORT_LEN     36
+#define STATS_DSP_REPORT_LEN       56
+#define SIDETONE_REPORT_LEN        2
+#define CONFIG_REPORT_LEN          56
+
+enum
+{
+    ITF_NUM_HID,
+    ITF_NUM_AUDIO_CONTROL,
+    ITF_NUM_AUDIO_STREAMING_MIC,
+    ITF_NUM_AUDIO_STREAMING_SPK,
+    ITF_NUM_TOTAL
+};
+
+// Audio function entities, as addressed by class requests
 enum
 {
-    REPORT_ID_KEYBOARD = 1
+    UAC_ENTITY_MIC_TERMINAL = 0x01, // input terminal, the handset capsule
+    UAC_ENTITY_MIC_FEATURE  = 0x02, // mute
+    UAC_ENTITY_MIC_USB      = 0x03, // output terminal, the IN stream
+    UAC_ENTITY_CLOCK        = 0x04, // fixed internal clock, AUDIO_SAMPLE_RATE
+    UAC_ENTITY_SPK_USB      = 0x05, // input terminal, the OUT stream
+    UAC_ENTITY_SPK_FEATURE  = 0x06, // mute and volume
+    UAC_ENTITY_SPK_TERMINAL = 0x07  // output terminal, the earpiece
 };
 
 #endif /* USB_DESCRIPTORS_H_ */